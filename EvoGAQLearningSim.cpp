@@ -17,15 +17,118 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <cstdio>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <type_traits>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+// スレッドの CPU 固定 (--pin-threads) は Linux のみ
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define EVO_HAS_THREAD_AFFINITY 1
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// AVX2 は target 属性で個別にコンパイルし、実行時に CPU を見て切り替える
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EVO_HAS_AVX2_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+//----------------------------------------------------------
+// 乱数
+//   rand() はプロセス全体で1系列なので、ワールドごと (スレッドごと) に
+//   独立した xorshift 系列を持てるようにする
+//   RandomScope で「現在の系列」を切り替え、未指定ならスレッド既定の系列を使う
+//----------------------------------------------------------
+struct RandomStream {
+    uint32_t state;
+
+    explicit RandomStream(uint32_t seed = 2463534242u) {
+        reseed(seed);
+    }
+
+    void reseed(uint32_t seed) {
+        state = (seed != 0u) ? seed : 0x6C078965u; // 0 は不動点なので避ける
+    }
+
+    uint32_t next() {
+        uint32_t x = state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        state = x;
+        return x;
+    }
+};
+
+thread_local RandomStream  threadRandom;
+thread_local RandomStream* activeRandom = nullptr;
+
+inline RandomStream& currentRandom() {
+    return activeRandom ? *activeRandom : threadRandom;
+}
+
+// スレッド既定の系列の種を設定
+inline void seedRandom(uint32_t seed) {
+    threadRandom.reseed(seed);
+}
+
+// スコープ内で使う乱数系列を切り替える
+class RandomScope {
+public:
+    explicit RandomScope(RandomStream& s) : prev(activeRandom) {
+        activeRandom = &s;
+    }
+    ~RandomScope() {
+        activeRandom = prev;
+    }
+private:
+    RandomStream* prev;
+};
 
 //----------------------------------------------------------
 // ユーティリティ関数
 //----------------------------------------------------------
+
+// 0 ~ 2^31-1 の一様乱数 (rand() の代わり)
+inline int randomInt() {
+    return (int)(currentRandom().next() >> 1);
+}
+
 float getRandomFloat(float minVal, float maxVal) {
-    float t = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+    float t = static_cast<float>(currentRandom().next() >> 8) * (1.f / 16777215.f);
     return minVal + t * (maxVal - minVal);
 }
 
+// ワールドの大きさ
+const float WORLD_WIDTH  = 800.f;
+const float WORLD_HEIGHT = 600.f;
+
 // 距離計算
 float distance2(sf::Vector2f a, sf::Vector2f b) {
     float dx = a.x - b.x;
@@ -34,531 +137,5867 @@ float distance2(sf::Vector2f a, sf::Vector2f b) {
 }
 
 //----------------------------------------------------------
-// 遺伝子情報 (GA 用)
+// コンパイル時ループ展開: f(0), f(1), ..., f(N-1)
+//   (インデックスは std::integral_constant で渡るので定数として扱える)
 //----------------------------------------------------------
-struct Genes {
-    float speed;            // 移動速度
-    float attack;           // 攻撃力
-    bool poison;            // 毒性の有無
-    int   legs;             // 脚の本数
-    float senseRange;       // 感知範囲
-    float poisonResistance; // 毒耐性(0.0 ~ 1.0程度を想定)
+template <class F, int... I>
+inline void unrollImpl(F&& f, std::integer_sequence<int, I...>) {
+    int dummy[] = { 0, (f(std::integral_constant<int, I>()), 0)... };
+    (void)dummy;
+}
+
+template <int N, class F>
+inline void unroll(F&& f) {
+    unrollImpl(f, std::make_integer_sequence<int, N>());
+}
 
-    static Genes crossoverAndMutate(const Genes& g1, const Genes& g2) {
-        Genes child;
-        // 親どちらかから引き継ぐ (50%の確率)
-        child.speed           = (rand() % 2 == 0) ? g1.speed : g2.speed;
-        child.attack          = (rand() % 2 == 0) ? g1.attack : g2.attack;
-        child.poison          = (rand() % 2 == 0) ? g1.poison : g2.poison;
-        child.legs            = (rand() % 2 == 0) ? g1.legs   : g2.legs;
-        child.senseRange      = (rand() % 2 == 0) ? g1.senseRange : g2.senseRange;
-        child.poisonResistance= (rand() % 2 == 0) ? g1.poisonResistance : g2.poisonResistance;
-
-        // 突然変異 (確率は適宜調整)
-        if (rand() % 100 < 10) child.speed += getRandomFloat(-0.5f, 0.5f);
-        if (rand() % 100 < 10) child.attack += getRandomFloat(-1.f, 1.f);
-        if (rand() % 100 < 10) child.senseRange += getRandomFloat(-20.f, 20.f);
-        if (rand() % 100 < 5) {
-            child.legs += (rand() % 3) - 1; // -1, 0, +1
-            if (child.legs < 1) child.legs = 1;
-        }
-        if (rand() % 100 < 5) {
-            child.poison = !child.poison;
-        }
-        if (rand() % 100 < 10) {
-            // 0.0 ~ 1.0 の範囲で少し変異
-            child.poisonResistance += getRandomFloat(-0.2f, 0.2f);
-        }
-
-        // 範囲制限
-        if (child.speed < 10.f)  child.speed = 10.f;
-        if (child.speed > 200.f) child.speed = 200.f;
-        if (child.attack < 0.f)  child.attack = 0.f;
-        if (child.attack > 50.f) child.attack = 50.f;
-        if (child.senseRange < 20.f)  child.senseRange = 20.f;
-        if (child.senseRange > 300.f) child.senseRange = 300.f;
-        if (child.poisonResistance < 0.f) child.poisonResistance = 0.f;
-        if (child.poisonResistance > 1.f) child.poisonResistance = 1.f;
+//----------------------------------------------------------
+// ベクトル化乱数 (xorshift32 × 4レーン)
+//   randomInt() を個体ごとに呼ぶ代わりに 4 個体分をまとめて生成する
+//----------------------------------------------------------
+struct LaneRng {
+    static const int LANES = 4;
+    alignas(16) uint32_t state[LANES];
 
-        return child;
+    explicit LaneRng(uint32_t seed = 2463534242u) {
+        for(int i=0; i<LANES; i++){
+            // 0 は xorshift の不動点なので避ける
+            uint32_t v = seed ^ (0x9E3779B9u * (uint32_t)(i + 1));
+            state[i] = (v != 0u) ? v : 0x6C078965u;
+        }
+    }
+
+#if defined(__SSE2__)
+    __m128i next4() {
+        __m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(state));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+        x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+        x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        _mm_store_si128(reinterpret_cast<__m128i*>(state), x);
+        return x;
+    }
+#endif
+
+    // 4 レーン分の乱数 (SSE2 が無い環境でも next4() と同じ系列)
+    void nextBlock(uint32_t out[LANES]) {
+#if defined(__SSE2__)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), next4());
+#else
+        for(int i=0; i<LANES; i++){
+            uint32_t x = state[i];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            state[i] = x;
+            out[i] = x;
+        }
+#endif
+    }
+
+    // [lo,hi) の一様乱数で out[0..n) を埋める
+    void fillUniform(float* out, int n, float lo, float hi) {
+        const float scale = (hi - lo) * (1.f / 16777216.f);
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 vScale = _mm_set1_ps(scale);
+        const __m128 vLo    = _mm_set1_ps(lo);
+        for(; i + LANES <= n; i += LANES) {
+            __m128 u = _mm_cvtepi32_ps(_mm_srli_epi32(next4(), 8));
+            _mm_storeu_ps(out + i, _mm_add_ps(vLo, _mm_mul_ps(u, vScale)));
+        }
+#else
+        for(; i + LANES <= n; i += LANES) {
+            uint32_t r[LANES];
+            nextBlock(r);
+            for(int l=0; l<LANES; l++) {
+                out[i + l] = lo + (float)(r[l] >> 8) * scale;
+            }
+        }
+#endif
+        for(; i < n; i++) {
+            out[i] = lo + (float)(next() >> 8) * scale;
+        }
+    }
+
+    // 端数処理用 (レーン0のみ進める)
+    uint32_t next() {
+        uint32_t x = state[0];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        state[0] = x;
+        return x;
+    }
+
+    // [0,1) の一様乱数
+    float nextFloat() {
+        return (float)(next() >> 8) * (1.f / 16777216.f);
     }
 };
 
 //----------------------------------------------------------
-// Entity(生物や植物の基底クラス)
+// Qテーブルの共有単位
 //----------------------------------------------------------
-class Entity {
-public:
-    virtual ~Entity() = default;
-    virtual void update(float deltaTime) = 0;
-    virtual void draw(sf::RenderWindow& window) = 0;
-    virtual sf::Vector2f getPosition() const = 0;
-    virtual bool isAlive() const = 0;
-    virtual void onEaten() = 0;
+enum class QShareMode {
+    PerCreature, // 個体ごと (従来どおり)
+    Species,     // 同じ種族キーの個体で共有
+    Lineage      // 同じ始祖の子孫で共有
+};
+
+//----------------------------------------------------------
+// Q値の格納形式 (コンパイル時に選択)
+//   Element  : 1要素の型
+//   SCALED   : テーブルごとのスケールを使うか
+//   MAX_CODE : 符号の最大絶対値 (SCALED の場合のみ意味を持つ)
+//   DITHER   : 確率的丸めを使うか (微小な更新が丸めで消えるのを防ぐ)
+//   decode() / encode() : 格納値 ⇔ float (dither は確率的丸め用の [0,1) 乱数)
+//----------------------------------------------------------
+
+// float そのまま (既定)
+struct FloatQStorage {
+    typedef float Element;
+    static const bool SCALED = false;
+    static const int  MAX_CODE = 1;
+    static const bool DITHER = false;
+
+    static float decode(Element e, float /*scale*/) {
+        return e;
+    }
+
+    static Element encode(float v, float /*scale*/, float /*dither*/) {
+        return v;
+    }
+};
+
+// int8 + テーブルごとのスケール
+struct Int8QStorage {
+    typedef int8_t Element;
+    static const bool SCALED = true;
+    static const int  MAX_CODE = 127;
+    static const bool DITHER = true;
+
+    static float decode(Element e, float scale) {
+        return (float)e * scale;
+    }
+
+    static Element encode(float v, float scale, float dither) {
+        float q = std::floor(v / scale + dither);
+        if(q >  (float)MAX_CODE) q =  (float)MAX_CODE;
+        if(q < -(float)MAX_CODE) q = -(float)MAX_CODE;
+        return (Element)q;
+    }
+};
 
-    virtual float getCollisionRadius() const = 0;
+// fp16 (IEEE binary16)
+struct HalfQStorage {
+    typedef uint16_t Element;
+    static const bool SCALED = false;
+    static const int  MAX_CODE = 1;
+    static const bool DITHER = true;
+
+    static float decode(Element h, float /*scale*/) {
+        uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exp  = (h >> 10) & 0x1F;
+        uint32_t man  = h & 0x3FF;
+        uint32_t bits;
+        if(exp == 0) {
+            if(man == 0) {
+                bits = sign;
+            } else {
+                // 非正規化数を正規化
+                exp = 127 - 15 + 1;
+                while((man & 0x400) == 0) { man <<= 1; exp--; }
+                man &= 0x3FF;
+                bits = sign | (exp << 23) | (man << 13);
+            }
+        } else if(exp == 0x1F) {
+            bits = sign | 0x7F800000u | (man << 13);
+        } else {
+            bits = sign | ((exp + 127 - 15) << 23) | (man << 13);
+        }
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static Element encode(float v, float /*scale*/, float dither) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+        int32_t  exp  = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t man  = bits & 0x7FFFFF;
+        if(exp >= 0x1F) return (Element)(sign | 0x7C00);  // 飽和 (Q値の範囲では起きない)
+        if(exp <= 0) {
+            if(exp < -10) return sign;                     // 0 に丸める
+            man |= 0x800000;
+            uint32_t shift = (uint32_t)(14 - exp);
+            uint32_t half  = man >> shift;
+            if((man >> (shift - 1)) & 1) half++;           // 四捨五入
+            return (Element)(sign | half);
+        }
+        // 切り捨てる下位13bitに乱数を足してから切り捨てる (確率的丸め)
+        // 繰り上がりは指数部へそのまま伝播する
+        uint32_t half = ((uint32_t)exp << 10) | (man >> 13);
+        if((man & 0x1FFF) + (uint32_t)(dither * 8192.f) >= 0x2000) half++;
+        if(half >= 0x7C00) half = 0x7BFF;
+        return (Element)(sign | half);
+    }
 };
 
 //----------------------------------------------------------
-// Plant(植物: 動かない)
+// Qテーブル格納領域 (全個体分を連続メモリに配置)
+//   共有モードでは同じキーの個体が1つのスロットを参照カウントで共有し、
+//   Q値の更新は tick 中に溜めて applyPending() でまとめて反映する
+//   読み出しは常に float に復号し、書き込み時に Storage 形式へ再量子化する
 //----------------------------------------------------------
-class Plant : public Entity {
-private:
-    sf::CircleShape shape; 
-    bool alive;
+template <int States, int Actions, class Storage = FloatQStorage>
+class BasicQTableStore {
 public:
-    Plant(sf::Vector2f pos, float radius = 10.f, sf::Color color = sf::Color(120, 200, 120))
-        : alive(true)
-    {
-        shape.setRadius(radius);
-        shape.setOrigin(radius, radius);
-        shape.setPosition(pos);
-        shape.setFillColor(color);
+    static const int NUM_STATES  = States;
+    static const int NUM_ACTIONS = Actions;
+    static const int TABLE_SIZE  = NUM_STATES * NUM_ACTIONS;
+
+    typedef typename Storage::Element Element;
+
+    void setShareMode(QShareMode m) {
+        mode = m;
     }
 
-    void update(float /*deltaTime*/) override {
-        // 動かない
+    QShareMode shareMode() const {
+        return mode;
     }
 
-    void draw(sf::RenderWindow& window) override {
-        if (alive) {
-            window.draw(shape);
+    // 0 初期化済みのテーブルを確保してスロット番号を返す
+    int allocate() {
+        int slot;
+        if(!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = (int)refCounts.size();
+            values.resize(values.size() + TABLE_SIZE);
+            scales.push_back(0.f);
+            if(mode != QShareMode::PerCreature) {
+                pendingSum.resize(values.size(), 0.f);
+                pendingCount.resize(values.size(), 0);
+            }
+            refCounts.push_back(0);
+            slotKeys.push_back(-1);
         }
+        Element zero = Storage::encode(0.f, MIN_SCALE, 0.f);
+        std::fill(&values[(size_t)slot * TABLE_SIZE], &values[(size_t)slot * TABLE_SIZE] + TABLE_SIZE, zero);
+        scales[slot]    = MIN_SCALE;
+        refCounts[slot] = 1;
+        slotKeys[slot]  = -1;
+        return slot;
     }
 
-    sf::Vector2f getPosition() const override {
-        return shape.getPosition();
+    // key >= 0 なら共有テーブルを参照 (無ければ新規確保), key < 0 なら個体専用
+    int acquire(int key) {
+        if(key < 0) return allocate();
+        auto it = sharedSlots.find(key);
+        if(it != sharedSlots.end()) {
+            refCounts[it->second]++;
+            return it->second;
+        }
+        int slot = allocate();
+        slotKeys[slot] = key;
+        sharedSlots[key] = slot;
+        return slot;
     }
 
-    bool isAlive() const override {
-        return alive;
+    void release(int slot) {
+        if(--refCounts[slot] > 0) return;
+        if(slotKeys[slot] >= 0) {
+            sharedSlots.erase(slotKeys[slot]);
+            slotKeys[slot] = -1;
+        }
+        freeSlots.push_back(slot);
     }
 
-    float getCollisionRadius() const override {
-        return shape.getRadius();
+    int refCount(int slot) const {
+        return refCounts[slot];
     }
 
-    void onEaten() override {
-        alive = false;
+    // 使用中のテーブル数
+    int tableCount() const {
+        return (int)(refCounts.size() - freeSlots.size());
+    }
+
+    // Q[slot][index] += delta
+    //   個体ごとモードでは即時反映、共有モードでは tick 末まで保留
+    void addUpdate(int slot, int index, float delta) {
+        size_t i = (size_t)slot * TABLE_SIZE + index;
+        if(mode == QShareMode::PerCreature) {
+            store(slot, index, value(slot, index) + delta);
+            return;
+        }
+        if(pendingCount[i] == 0) touched.push_back(i);
+        pendingSum[i] += delta;
+        pendingCount[i]++;
+    }
+
+    // 保留中の更新をまとめて反映 (同じ要素への更新は平均して1回分として適用)
+    void applyPending() {
+        for(size_t i : touched) {
+            int slot  = (int)(i / TABLE_SIZE);
+            int index = (int)(i % TABLE_SIZE);
+            store(slot, index, value(slot, index) + pendingSum[i] / (float)pendingCount[i]);
+            pendingSum[i]   = 0.f;
+            pendingCount[i] = 0;
+        }
+        touched.clear();
+    }
+
+    float value(int slot, int index) const {
+        return Storage::decode(values[(size_t)slot * TABLE_SIZE + index], scales[slot]);
+    }
+
+    // 1行 (ある状態の全行動) を float で読み出す
+    void loadRow(int slot, int state, float* out) const {
+        const Element* e = &values[(size_t)slot * TABLE_SIZE + state * NUM_ACTIONS];
+        float sc = scales[slot];
+        unroll<NUM_ACTIONS>([&](auto k) {
+            out[decltype(k)::value] = Storage::decode(e[decltype(k)::value], sc);
+        });
+    }
+
+    // テーブル全体を float で読み書き (書き込み時はスケールを取り直す)
+    void loadTable(int slot, float* out) const {
+        const Element* e = &values[(size_t)slot * TABLE_SIZE];
+        float sc = scales[slot];
+        unroll<TABLE_SIZE>([&](auto k) {
+            out[decltype(k)::value] = Storage::decode(e[decltype(k)::value], sc);
+        });
+    }
+
+    void storeTable(int slot, const float* in) {
+        Element* e = &values[(size_t)slot * TABLE_SIZE];
+        if(Storage::SCALED) {
+            float maxAbs = 0.f;
+            for(int i=0; i<TABLE_SIZE; i++) maxAbs = std::max(maxAbs, std::fabs(in[i]));
+            scales[slot] = scaleFor(maxAbs);
+        }
+        float sc = scales[slot];
+        for(int i=0; i<TABLE_SIZE; i++) e[i] = Storage::encode(in[i], sc, dither());
+    }
+
+    // 行内の最大値 / そのインデックス (行動数で完全展開)
+    float maxValue(int slot, int state) const {
+        float r[NUM_ACTIONS];
+        loadRow(slot, state, r);
+        float m = r[0];
+        unroll<NUM_ACTIONS - 1>([&](auto k) {
+            const int a = decltype(k)::value + 1;
+            if(r[a] > m) m = r[a];
+        });
+        return m;
+    }
+
+    int argmax(int slot, int state) const {
+        float r[NUM_ACTIONS];
+        loadRow(slot, state, r);
+        float m = r[0];
+        int best = 0;
+        unroll<NUM_ACTIONS - 1>([&](auto k) {
+            const int a = decltype(k)::value + 1;
+            if(r[a] > m) { m = r[a]; best = a; }
+        });
+        return best;
+    }
+
+    // 1要素あたりのバイト数 + テーブルごとのスケール
+    static size_t bytesPerTable() {
+        return sizeof(Element) * TABLE_SIZE + (Storage::SCALED ? sizeof(float) : 0);
+    }
+
+private:
+    // スケールの下限 (0 付近の微小な値も表現できるよう)
+    static constexpr float MIN_SCALE = 1.f / 128.f;
+
+    static float scaleFor(float maxAbs) {
+        return std::max(maxAbs / (float)Storage::MAX_CODE, MIN_SCALE);
+    }
+
+    // 1要素を書き込む (範囲を超えたらテーブル全体を再量子化)
+    void store(int slot, int index, float v) {
+        if(Storage::SCALED && std::fabs(v) > scales[slot] * (float)Storage::MAX_CODE) {
+            float t[TABLE_SIZE];
+            loadTable(slot, t);
+            t[index] = v;
+            storeTable(slot, t);
+            return;
+        }
+        values[(size_t)slot * TABLE_SIZE + index] = Storage::encode(v, scales[slot], dither());
+    }
+
+    // 確率的丸め用の乱数
+    float dither() {
+        if(!Storage::DITHER) return 0.f;
+        ditherState ^= ditherState << 13;
+        ditherState ^= ditherState >> 17;
+        ditherState ^= ditherState << 5;
+        return (float)(ditherState >> 8) * (1.f / 16777216.f);
     }
+
+    QShareMode mode = QShareMode::PerCreature;
+
+    std::vector<Element> values;
+    std::vector<float>   scales;     // テーブルごとのスケール
+    std::vector<int>     refCounts;
+    std::vector<int>     slotKeys;   // 共有キー (個体専用なら -1)
+    std::vector<int>     freeSlots;
+    std::unordered_map<int, int> sharedSlots; // 共有キー → スロット
+    uint32_t ditherState = 0x2545F491u;
+
+    // 共有モード用の保留更新
+    std::vector<float>    pendingSum;
+    std::vector<uint32_t> pendingCount;
+    std::vector<size_t>   touched;
 };
 
+template <int S, int A, class St>
+constexpr float BasicQTableStore<S, A, St>::MIN_SCALE;
+
 //----------------------------------------------------------
-// Creature(動物的な生物) + GA(Genes) + Q学習
+// 行動選択バッチ (ε-greedy をまとめて計算)
+//   各個体は update() で状態を観測するだけにして、
+//   Q行の argmax と探索判定は全個体分を一括で処理する
 //----------------------------------------------------------
-class Creature : public Entity {
-private:
-    //------------------------------------------------------
-    // Q学習関連
-    //------------------------------------------------------
-    static const int NUM_STATES  = 4; // 00,01,10,11
-    static const int NUM_ACTIONS = 4; // 前進,左旋回,右旋回,停止
+template <class QStore>
+struct BasicActionBatch {
+    std::vector<int>   slots;    // Qテーブルのスロット
+    std::vector<int>   states;   // 観測した状態
+    std::vector<float> epsilons; // 各個体の ε
+    std::vector<int>   actions;  // 選択結果
 
-    float Q[NUM_STATES][NUM_ACTIONS];
+    void clear() {
+        slots.clear();
+        states.clear();
+        epsilons.clear();
+    }
 
-    float epsilon; // ε-greedy
-    float alpha;   // 学習率
-    float gamma;   // 割引率
+    void push(int slot, int state, float eps) {
+        slots.push_back(slot);
+        states.push_back(state);
+        epsilons.push_back(eps);
+    }
 
-    int   currentState;
-    int   currentAction;
+    int size() const {
+        return (int)slots.size();
+    }
 
-    //------------------------------------------------------
-    // 遺伝子
-    //------------------------------------------------------
-    Genes genes;
-    int generation;
+    void select(const QStore& q, LaneRng& rng) {
+        const int NA = QStore::NUM_ACTIONS;
+        int n = size();
+        actions.resize(n);
+        int i = 0;
+#if defined(__SSE2__)
+        for(; i + 4 <= n; i += 4) {
+            // 4個体分の Q 行を「行動ごと × 4個体」に並べて argmax
+            // (同値なら若い番号を優先: スカラー版と同じ)
+            float q0[NA], q1[NA], q2[NA], q3[NA];
+            q.loadRow(slots[i  ], states[i  ], q0);
+            q.loadRow(slots[i+1], states[i+1], q1);
+            q.loadRow(slots[i+2], states[i+2], q2);
+            q.loadRow(slots[i+3], states[i+3], q3);
+            __m128  best  = _mm_setr_ps(q0[0], q1[0], q2[0], q3[0]);
+            __m128i bestA = _mm_setzero_si128();
+            unroll<NA - 1>([&](auto k) {
+                const int a = decltype(k)::value + 1;
+                __m128  col = _mm_setr_ps(q0[a], q1[a], q2[a], q3[a]);
+                __m128  gt  = _mm_cmpgt_ps(col, best);
+                __m128i gi  = _mm_castps_si128(gt);
+                best  = _mm_or_ps(_mm_and_ps(gt, col), _mm_andnot_ps(gt, best));
+                bestA = _mm_or_si128(_mm_and_si128(gi, _mm_set1_epi32(a)),
+                                     _mm_andnot_si128(gi, bestA));
+            });
 
-    //------------------------------------------------------
-    // 物理・描画関連
-    //------------------------------------------------------
-    sf::Vector2f position;
-    float direction;   
-    sf::CircleShape shape;
-    bool alive;
-    float energy;
+            // 探索マスク: u < ε
+            __m128i r1 = rng.next4();
+            __m128  u  = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(r1, 8)),
+                                    _mm_set1_ps(1.f / 16777216.f));
+            __m128i explore = _mm_castps_si128(_mm_cmplt_ps(u, _mm_loadu_ps(&epsilons[i])));
 
-    float reproductionCoolDown;
+            // ランダム行動: 上位16bit × NA >> 16
+            __m128i r2 = _mm_srli_epi32(rng.next4(), 16);
+            __m128i randA = _mm_mulhi_epu16(r2, _mm_set1_epi32(NA));
 
-    //------------------------------------------------------
-    // ★追加: 生存時間・子孫数
-    //------------------------------------------------------
-    float lifetime;       // 生存時間 (秒)
-    int   offspringCount; // 産んだ子孫の数
+            __m128i act = _mm_or_si128(_mm_and_si128(explore, randA),
+                                       _mm_andnot_si128(explore, bestA));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&actions[i]), act);
+        }
+#endif
+        for(; i < n; i++) {
+            if(rng.nextFloat() < epsilons[i]) {
+                actions[i] = (int)(((rng.next() >> 16) * (uint32_t)NA) >> 16);
+                continue;
+            }
+            actions[i] = q.argmax(slots[i], states[i]);
+        }
+    }
+};
 
-    //------------------------------------------------------
-    // すべての Entity への参照
-    //------------------------------------------------------
-    const std::vector<std::shared_ptr<Entity>>* pAllEntities;
+//----------------------------------------------------------
+// シミュレーションの調整用パラメータ
+//   既定値は従来のハードコード値と同じ
+//   (パラメータスイープで名前から書き換えられるよう全て float)
+//----------------------------------------------------------
+struct SimParams {
+    // 突然変異の確率 (%)
+    float mutateSpeed      = 10.f;
+    float mutateAttack     = 10.f;
+    float mutateSense      = 10.f;
+    float mutateLegs       = 5.f;
+    float mutatePoison     = 5.f;
+    float mutateResistance = 10.f;
 
-public:
-    // コンストラクタ
-    Creature(const Genes& g, sf::Vector2f pos, sf::Color color,
-             int gen,
-             const std::vector<std::shared_ptr<Entity>>* allEntities)
-        : genes(g), generation(gen), position(pos),
-          direction(getRandomFloat(0.f, 360.f)),
-          alive(true),
-          energy(60.f),
-          reproductionCoolDown(0.f),
-          lifetime(0.f),          // ★追加
-          offspringCount(0),      // ★追加
-          pAllEntities(allEntities)
-    {
-        // Qテーブルを0初期化
-        for(int s=0; s<NUM_STATES; s++){
-            for(int a=0; a<NUM_ACTIONS; a++){
-                Q[s][a] = 0.f;
-            }
+    // 報酬
+    float stepReward       = -0.002f;  // 毎 tick の微小な負の報酬
+    float starvePenalty    = -10.f;    // 餓死時の基本ペナルティ
+    float eatenPenalty     = -40.f;    // 捕食された時の基本ペナルティ
+    float offspringBonus   = 5.f;      // 死亡時、子孫1体あたりの緩和
+    float lifetimeBonus    = 0.1f;     // 死亡時、生存1秒あたりの緩和
+    float plantReward      = 5.f;      // 植物を食べた時
+    float predationReward  = 10.f;     // 他の Creature を食べた時
+
+    // エネルギー
+    float plantEnergy      = 15.f;     // 植物を食べた時
+    float preyEnergy       = 25.f;     // 攻撃力で勝って食べた時
+    float counterEnergy    = 30.f;     // 相手から襲われて逆に食べた時
+    float childEnergyShare = 0.6f;     // 繁殖時に子へ渡す割合 (親は残りを保持)
+    float drainRate        = 0.4f;     // 代謝 (エネルギー/秒)
+
+    // Q学習
+    float epsilon          = 0.2f;
+    float alpha            = 0.1f;
+    float gamma            = 0.9f;
+
+    // 名前から該当メンバを引く (見つからなければ nullptr)
+    float* find(const std::string& name) {
+        struct Entry { const char* name; float SimParams::* member; };
+        static const Entry table[] = {
+            { "mutate-speed",       &SimParams::mutateSpeed },
+            { "mutate-attack",      &SimParams::mutateAttack },
+            { "mutate-sense",       &SimParams::mutateSense },
+            { "mutate-legs",        &SimParams::mutateLegs },
+            { "mutate-poison",      &SimParams::mutatePoison },
+            { "mutate-resistance",  &SimParams::mutateResistance },
+            { "step-reward",        &SimParams::stepReward },
+            { "starve-penalty",     &SimParams::starvePenalty },
+            { "eaten-penalty",      &SimParams::eatenPenalty },
+            { "offspring-bonus",    &SimParams::offspringBonus },
+            { "lifetime-bonus",     &SimParams::lifetimeBonus },
+            { "plant-reward",       &SimParams::plantReward },
+            { "predation-reward",   &SimParams::predationReward },
+            { "plant-energy",       &SimParams::plantEnergy },
+            { "prey-energy",        &SimParams::preyEnergy },
+            { "counter-energy",     &SimParams::counterEnergy },
+            { "child-energy-share", &SimParams::childEnergyShare },
+            { "drain-rate",         &SimParams::drainRate },
+            { "epsilon",            &SimParams::epsilon },
+            { "alpha",              &SimParams::alpha },
+            { "gamma",              &SimParams::gamma },
+        };
+        for(const Entry& e : table) {
+            if(name == e.name) return &(this->*e.member);
         }
-        // ε-greedyのパラメータ
-        epsilon = 0.2f;  
-        alpha   = 0.1f;
-        gamma   = 0.9f;
+        return nullptr;
+    }
+};
+
+//----------------------------------------------------------
+// 遺伝子情報 (GA 用)
+//----------------------------------------------------------
+struct Genes {
+    float speed;            // 移動速度
+    float attack;           // 攻撃力
+    bool poison;            // 毒性の有無
+    int   legs;             // 脚の本数
+    float senseRange;       // 感知範囲
+    float poisonResistance; // 毒耐性(0.0 ~ 1.0程度を想定)
 
-        shape.setRadius(15.f);
-        shape.setOrigin(15.f, 15.f);
-        shape.setPosition(pos);
-        color.a = 180;
-        shape.setFillColor(color);
+    // 種族分類 (0,1,2 = 低/中/高)
+    int speedClass() const {
+        if(speed < 60.f)  return 0;
+        if(speed < 120.f) return 1;
+        return 2;
+    }
 
-        direction = getRandomFloat(0.f, 360.f);
-        currentState  = 0;
-        currentAction = 0;
+    int attackClass() const {
+        if(attack < 10.f) return 0;
+        if(attack < 30.f) return 1;
+        return 2;
+    }
+
+    int resistanceClass() const {
+        if(poisonResistance < 0.33f) return 0;
+        if(poisonResistance < 0.66f) return 1;
+        return 2;
+    }
+
+    // 種族名と1対1に対応する整数キー
+    int speciesKey() const {
+        int cls = ((speedClass() * 3 + attackClass()) * 2 + (poison ? 1 : 0)) * 3 + resistanceClass();
+        return (cls << 16) | (legs & 0xFFFF);
+    }
+
+    // 種族キーから種族名を作る (系統ログの解析でも使う)
+    static std::string speciesName(int key) {
+        static const char* speedNames[]  = { "Slow", "Mid", "Fast" };
+        static const char* attackNames[] = { "LowAtk", "MedAtk", "HighAtk" };
+        static const char* resistNames[] = { "LowRes", "MidRes", "HighRes" };
+
+        int cls  = key >> 16;
+        int legs = key & 0xFFFF;
+        int resistClass = cls % 3;  cls /= 3;
+        bool poison     = cls % 2;  cls /= 2;
+        int attackClass = cls % 3;  cls /= 3;
+        int speedClass  = cls % 3;
+
+        std::string speedCat  = speedNames[speedClass];
+        std::string attackCat = attackNames[attackClass];
+
+        std::string poisonCat = poison ? "Poison" : "NonPois";
+
+        std::string legsStr = "Leg" + std::to_string(legs);
+
+        std::string resistCat = resistNames[resistClass];
+
+        return speedCat + "_" + attackCat + "_" + poisonCat + "_" + legsStr + "_" + resistCat;
+    }
+};
+
+//----------------------------------------------------------
+// 遺伝子の SoA (4 個体ずつ SIMD で処理できるよう 4 の倍数で確保)
+//----------------------------------------------------------
+struct GeneLanes {
+    std::vector<float>   speed;
+    std::vector<float>   attack;
+    std::vector<float>   senseRange;
+    std::vector<float>   poisonResistance;
+    std::vector<int32_t> legs;
+    std::vector<int32_t> poison;   // 0 / -1
+
+    void resize(size_t n) {
+        speed.resize(n);
+        attack.resize(n);
+        senseRange.resize(n);
+        poisonResistance.resize(n);
+        legs.resize(n);
+        poison.resize(n);
+    }
+
+    void set(size_t i, const Genes& g) {
+        speed[i]            = g.speed;
+        attack[i]           = g.attack;
+        senseRange[i]       = g.senseRange;
+        poisonResistance[i] = g.poisonResistance;
+        legs[i]             = g.legs;
+        poison[i]           = g.poison ? -1 : 0;
     }
 
-    void update(float deltaTime) override {
-        if(!alive) return;
+    Genes get(size_t i) const {
+        Genes g;
+        g.speed            = speed[i];
+        g.attack           = attack[i];
+        g.senseRange       = senseRange[i];
+        g.poisonResistance = poisonResistance[i];
+        g.legs             = legs[i];
+        g.poison           = poison[i] != 0;
+        return g;
+    }
+};
+
+//----------------------------------------------------------
+// 出生バッチ (1 tick 分の交叉・突然変異をまとめて計算)
+//   4 個体ごとに LaneRng から乱数を 10 ブロック引き、
+//     ブロック0    : 交叉マスク (遺伝子ごとに1ビット)
+//     ブロック1〜3 : 突然変異の判定 (16ビットずつ, 1ブロックで2遺伝子)
+//     ブロック4〜8 : 突然変異量 (速度・攻撃力・感知範囲・毒耐性・脚の本数)
+//     ブロック9    : 体色のゆらぎ (10ビットずつ RGB)
+//   範囲制限は SIMD の min/max で行う
+//----------------------------------------------------------
+struct GeneBatch {
+    GeneLanes parentA, parentB, child;
+    std::vector<sf::Color> colorA, colorB, childColor;
+
+    void clear() {
+        count = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    void push(const Genes& a, const Genes& b, sf::Color ca, sf::Color cb) {
+        if(count + 4 > padded()) {
+            size_t n = padded() == 0 ? 16 : padded() * 2;
+            parentA.resize(n);
+            parentB.resize(n);
+            child.resize(n);
+            colorA.resize(n);
+            colorB.resize(n);
+            childColor.resize(n);
+        }
+        parentA.set(count, a);
+        parentB.set(count, b);
+        colorA[count] = ca;
+        colorB[count] = cb;
+        count++;
+    }
+
+    void generate(const SimParams& p, LaneRng& rng) {
+        // 端数レーンは親Aの先頭をコピーして埋める (結果は使わない)
+        size_t end = (count + 3) & ~(size_t)3;
+        for(size_t i=count; i<end; i++) {
+            parentA.set(i, parentA.get(0));
+            parentB.set(i, parentB.get(0));
+            colorA[i] = colorA[0];
+            colorB[i] = colorB[0];
+        }
+
+        // 判定しきい値 (16ビット乱数がこれ未満なら突然変異)
+        const int32_t tSpeed  = threshold(p.mutateSpeed);
+        const int32_t tAttack = threshold(p.mutateAttack);
+        const int32_t tSense  = threshold(p.mutateSense);
+        const int32_t tLegs   = threshold(p.mutateLegs);
+        const int32_t tPoison = threshold(p.mutatePoison);
+        const int32_t tResist = threshold(p.mutateResistance);
+
+        alignas(16) uint32_t r[10][LaneRng::LANES];
+        for(size_t i=0; i<end; i+=4) {
+            for(int k=0; k<10; k++) {
+                rng.nextBlock(r[k]);
+            }
+#if defined(__SSE2__)
+            const __m128i low16 = _mm_set1_epi32(0xFFFF);
+            const __m128  toUnit = _mm_set1_ps(1.f / 16777216.f);
+            __m128i cross = _mm_load_si128(reinterpret_cast<const __m128i*>(r[0]));
+            __m128i roll1 = _mm_load_si128(reinterpret_cast<const __m128i*>(r[1]));
+            __m128i roll2 = _mm_load_si128(reinterpret_cast<const __m128i*>(r[2]));
+            __m128i roll3 = _mm_load_si128(reinterpret_cast<const __m128i*>(r[3]));
+
+            // 交叉マスク (ビットが立っていれば親B)
+            auto crossMask = [&](int bit) {
+                __m128i b = _mm_set1_epi32(1 << bit);
+                return _mm_cmpeq_epi32(_mm_and_si128(cross, b), b);
+            };
+            auto selectPs = [](__m128i m, __m128 a, __m128 b) {
+                __m128 fm = _mm_castsi128_ps(m);
+                return _mm_or_ps(_mm_andnot_ps(fm, a), _mm_and_ps(fm, b));
+            };
+            auto selectEpi = [](__m128i m, __m128i a, __m128i b) {
+                return _mm_or_si128(_mm_andnot_si128(m, a), _mm_and_si128(m, b));
+            };
+            // 突然変異マスク
+            auto rollMask = [&](__m128i roll, bool high, int32_t t) {
+                __m128i v = high ? _mm_srli_epi32(roll, 16) : _mm_and_si128(roll, low16);
+                return _mm_cmplt_epi32(v, _mm_set1_epi32(t));
+            };
+            // 突然変異量 [lo,hi)
+            auto amount = [&](int k, float lo, float hi) {
+                __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(r[k]));
+                __m128  u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 8)), toUnit);
+                return _mm_add_ps(_mm_set1_ps(lo), _mm_mul_ps(u, _mm_set1_ps(hi - lo)));
+            };
+            auto mutate = [&](const std::vector<float>& a, const std::vector<float>& b, std::vector<float>& out,
+                              int bit, __m128i mut, __m128 delta, float lo, float hi) {
+                __m128 v = selectPs(crossMask(bit), _mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i]));
+                v = _mm_add_ps(v, _mm_and_ps(_mm_castsi128_ps(mut), delta));
+                v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+                _mm_storeu_ps(&out[i], v);
+            };
+
+            mutate(parentA.speed, parentB.speed, child.speed,
+                   0, rollMask(roll1, false, tSpeed), amount(4, -0.5f, 0.5f), 10.f, 200.f);
+            mutate(parentA.attack, parentB.attack, child.attack,
+                   1, rollMask(roll1, true, tAttack), amount(5, -1.f, 1.f), 0.f, 50.f);
+            mutate(parentA.senseRange, parentB.senseRange, child.senseRange,
+                   2, rollMask(roll2, false, tSense), amount(6, -20.f, 20.f), 20.f, 300.f);
+            mutate(parentA.poisonResistance, parentB.poisonResistance, child.poisonResistance,
+                   3, rollMask(roll3, true, tResist), amount(7, -0.2f, 0.2f), 0.f, 1.f);
+
+            // 脚の本数: -1, 0, +1 を加えて 1 未満なら 1
+            {
+                __m128i v = selectEpi(crossMask(4),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&parentA.legs[i])),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&parentB.legs[i])));
+                __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(r[8]));
+                d = _mm_sub_epi32(_mm_mulhi_epu16(_mm_srli_epi32(d, 16), _mm_set1_epi32(3)),
+                                  _mm_set1_epi32(1));
+                v = _mm_add_epi32(v, _mm_and_si128(rollMask(roll2, true, tLegs), d));
+                __m128i one = _mm_set1_epi32(1);
+                v = selectEpi(_mm_cmplt_epi32(v, one), v, one);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&child.legs[i]), v);
+            }
+
+            // 毒性: 突然変異で反転
+            {
+                __m128i v = selectEpi(crossMask(5),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&parentA.poison[i])),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&parentB.poison[i])));
+                v = _mm_xor_si128(v, rollMask(roll3, false, tPoison));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&child.poison[i]), v);
+            }
+#else
+            for(int l=0; l<LaneRng::LANES; l++) {
+                const size_t j = i + l;
+                auto pick = [&](int bit) { return (r[0][l] >> bit) & 1u; };
+                auto rolled = [&](int k, bool high, int32_t t) {
+                    int32_t v = (int32_t)(high ? (r[k][l] >> 16) : (r[k][l] & 0xFFFFu));
+                    return v < t;
+                };
+                auto amount = [&](int k, float lo, float hi) {
+                    return lo + (float)(r[k][l] >> 8) * (1.f / 16777216.f) * (hi - lo);
+                };
+                auto clampf = [](float v, float lo, float hi) { return std::min(std::max(v, lo), hi); };
+
+                float sp = pick(0) ? parentB.speed[j] : parentA.speed[j];
+                if(rolled(1, false, tSpeed)) sp += amount(4, -0.5f, 0.5f);
+                child.speed[j] = clampf(sp, 10.f, 200.f);
+
+                float at = pick(1) ? parentB.attack[j] : parentA.attack[j];
+                if(rolled(1, true, tAttack)) at += amount(5, -1.f, 1.f);
+                child.attack[j] = clampf(at, 0.f, 50.f);
+
+                float se = pick(2) ? parentB.senseRange[j] : parentA.senseRange[j];
+                if(rolled(2, false, tSense)) se += amount(6, -20.f, 20.f);
+                child.senseRange[j] = clampf(se, 20.f, 300.f);
+
+                float re = pick(3) ? parentB.poisonResistance[j] : parentA.poisonResistance[j];
+                if(rolled(3, true, tResist)) re += amount(7, -0.2f, 0.2f);
+                child.poisonResistance[j] = clampf(re, 0.f, 1.f);
+
+                int32_t lg = pick(4) ? parentB.legs[j] : parentA.legs[j];
+                if(rolled(2, true, tLegs)) lg += (int32_t)(((r[8][l] >> 16) * 3u) >> 16) - 1;
+                child.legs[j] = std::max(lg, (int32_t)1);
+
+                int32_t po = pick(5) ? parentB.poison[j] : parentA.poison[j];
+                if(rolled(3, false, tPoison)) po = ~po;
+                child.poison[j] = po;
+            }
+#endif
+            // 体色: 両親の平均 ± 5
+            for(int l=0; l<LaneRng::LANES; l++) {
+                const size_t j = i + l;
+                uint32_t w = r[9][l];
+                int jr = (int)(((w         & 0x3FFu) * 11u) >> 10) - 5;
+                int jg = (int)((((w >> 10) & 0x3FFu) * 11u) >> 10) - 5;
+                int jb = (int)((((w >> 20) & 0x3FFu) * 11u) >> 10) - 5;
+                const sf::Color& a = colorA[j];
+                const sf::Color& b = colorB[j];
+                childColor[j] = sf::Color(
+                    (sf::Uint8)std::min(255, std::max(0, (a.r + b.r)/2 + jr)),
+                    (sf::Uint8)std::min(255, std::max(0, (a.g + b.g)/2 + jg)),
+                    (sf::Uint8)std::min(255, std::max(0, (a.b + b.b)/2 + jb)),
+                    180);
+            }
+        }
+    }
+
+private:
+    size_t count = 0;
+
+    size_t padded() const {
+        return child.speed.size();
+    }
+
+    static int32_t threshold(float percent) {
+        return (int32_t)(std::min(std::max(percent, 0.f), 100.f) * 655.36f);
+    }
+};
+
+//----------------------------------------------------------
+// 系統ログのレコード (固定長 56 バイト, リトルエンディアン)
+//   出生・死亡のどちらも対象個体の遺伝子を持つので、
+//   ログだけで系統樹と種の増減を再構成できる
+//----------------------------------------------------------
+enum class LineageKind : uint8_t {
+    Founder   = 1,   // 初期個体
+    Birth     = 2,   // 出生 (other1: 親A, other2: 親B)
+    Death     = 3,   // 死亡 (cause 参照, other1: 捕食者)
+    Immigrant = 4    // 島モデルでの移住先への到着 (other1: 移住元での ID, other2: 移住元の島番号)
+};
+
+enum class DeathCause : uint8_t {
+    None     = 0,
+    Starved  = 1,
+    Eaten    = 2,
+    Emigrated = 3   // 島モデルで他の島へ移った
+};
+
+#pragma pack(push, 1)
+struct LineageRecord {
+    uint64_t tick;
+    uint64_t id;
+    uint64_t other1;
+    uint64_t other2;
+    uint32_t generation;
+    int32_t  lineage;
+    uint32_t species;          // Genes::speciesKey()
+    uint16_t speed;            // 遺伝子 (固定小数点, 下の pack/unpack 参照)
+    uint16_t attack;
+    uint16_t senseRange;
+    uint16_t poisonResistance;
+    uint8_t  kind;             // LineageKind
+    uint8_t  cause;            // DeathCause
+    uint8_t  legs;
+    uint8_t  poison;
+};
+#pragma pack(pop)
+static_assert(sizeof(LineageRecord) == 56, "LineageRecord layout changed");
+
+// ファイル先頭のヘッダ (解析ツールが形式を確認する)
+struct LineageHeader {
+    char     magic[8];         // "EVOLIN1"
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+static_assert(sizeof(LineageHeader) == 16, "LineageHeader layout changed");
+
+// 遺伝子の固定小数点表現 (速度・感知範囲 0.01, 攻撃力 0.001, 毒耐性 1/65535 刻み)
+inline void packGenes(const Genes& g, LineageRecord& r) {
+    auto q = [](float v, float scale) {
+        return (uint16_t)std::min(65535.f, std::max(0.f, v * scale + 0.5f));
+    };
+    r.speed            = q(g.speed, 100.f);
+    r.attack           = q(g.attack, 1000.f);
+    r.senseRange       = q(g.senseRange, 100.f);
+    r.poisonResistance = q(g.poisonResistance, 65535.f);
+    r.legs             = (uint8_t)std::min(g.legs, 255);
+    r.poison           = g.poison ? 1 : 0;
+    r.species          = (uint32_t)g.speciesKey();
+}
+
+inline Genes unpackGenes(const LineageRecord& r) {
+    Genes g;
+    g.speed            = r.speed / 100.f;
+    g.attack           = r.attack / 1000.f;
+    g.senseRange       = r.senseRange / 100.f;
+    g.poisonResistance = r.poisonResistance / 65535.f;
+    g.legs             = r.legs;
+    g.poison           = r.poison != 0;
+    return g;
+}
+
+//----------------------------------------------------------
+// 系統ログ (メモリマップした追記専用ファイル)
+//   append はマップ済み領域への 1 レコードの書き込みだけ
+//   tick の境目の reserveAhead() で、残りが少なければ倍のサイズに広げてマップし直しておくので、
+//   tick の途中で広げるのは 1 tick で残りを使い切った時だけ。close で実サイズに切り詰める
+//   広げられなかった場合はエラーを出してそこで記録をやめる (シミュレーションは止めない)
+//   (異常終了した場合は末尾が kind == 0 のレコードで埋まる)
+//----------------------------------------------------------
+class LineageLog {
+public:
+    LineageLog() = default;
+    LineageLog(const LineageLog&) = delete;
+    LineageLog& operator=(const LineageLog&) = delete;
+
+    ~LineageLog() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) return false;
+        if(!remap(INITIAL_BYTES)) {
+            close();
+            return false;
+        }
+        LineageHeader* h = reinterpret_cast<LineageHeader*>(base);
+        std::memcpy(h->magic, "EVOLIN1", 8);
+        h->recordSize = sizeof(LineageRecord);
+        h->reserved   = 0;
+        used = sizeof(LineageHeader);
+        return true;
+    }
+
+    void close() {
+        if(base) {
+            ::munmap(base, mapped);
+            base = nullptr;
+        }
+        if(fd >= 0) {
+            if(::ftruncate(fd, (off_t)used) != 0) {
+                std::cerr << "Warning: failed to truncate lineage log\n";
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        mapped = 0;
+        used   = 0;
+    }
+
+    bool enabled() const {
+        return base != nullptr;
+    }
+
+    uint64_t recordCount() const {
+        return used > sizeof(LineageHeader) ? (used - sizeof(LineageHeader)) / sizeof(LineageRecord) : 0;
+    }
+
+    // tick の境目で呼ぶ: 残りが現在のサイズの 1/4 を切っていたら先に広げておく
+    void reserveAhead() {
+        if(base && (mapped - used) * 4 < mapped) grow();
+    }
+
+    // 書き込み先のレコードを確保して返す (呼び出し側が全フィールドを埋める)
+    //   広げられずに記録をやめた場合は捨てる領域を返す
+    LineageRecord& append() {
+        if(!base || (used + sizeof(LineageRecord) > mapped && !grow())) {
+            return discarded;
+        }
+        LineageRecord* r = reinterpret_cast<LineageRecord*>(base + used);
+        used += sizeof(LineageRecord);
+        return *r;
+    }
+
+    void recordBirth(LineageKind kind, uint64_t tick, uint64_t id, uint64_t other1, uint64_t other2,
+                     const Genes& g, int generation, int lineage) {
+        LineageRecord r;
+        r.tick       = tick;
+        r.id         = id;
+        r.other1     = other1;
+        r.other2     = other2;
+        r.generation = (uint32_t)generation;
+        r.lineage    = lineage;
+        r.kind       = (uint8_t)kind;
+        r.cause      = (uint8_t)DeathCause::None;
+        packGenes(g, r);
+        append() = r;
+    }
+
+    void recordDeath(DeathCause cause, uint64_t tick, uint64_t id, uint64_t predator,
+                     const Genes& g, int generation, int lineage) {
+        LineageRecord r;
+        r.tick       = tick;
+        r.id         = id;
+        r.other1     = predator;
+        r.other2     = 0;
+        r.generation = (uint32_t)generation;
+        r.lineage    = lineage;
+        r.kind       = (uint8_t)LineageKind::Death;
+        r.cause      = (uint8_t)cause;
+        packGenes(g, r);
+        append() = r;
+    }
+
+private:
+    static const size_t INITIAL_BYTES = 64u << 20;   // 約 120 万レコード
+
+    int    fd     = -1;
+    char*  base   = nullptr;
+    size_t mapped = 0;
+    size_t used   = 0;
+    LineageRecord discarded;
+
+    // 倍のサイズに広げる。失敗したらそこまでの記録を残して閉じる
+    bool grow() {
+        if(remap(mapped * 2)) return true;
+        const int err = errno;
+        std::cerr << "Error: failed to grow lineage log (" << std::strerror(err) << "); "
+                  << "logging stopped after " << recordCount() << " records\n";
+        close();
+        return false;
+    }
+
+    bool remap(size_t bytes) {
+        if(base) {
+            ::munmap(base, mapped);
+            base = nullptr;
+        }
+        if(::ftruncate(fd, (off_t)bytes) != 0) return false;
+        void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED) return false;
+        base   = static_cast<char*>(p);
+        mapped = bytes;
+        return true;
+    }
+};
+
+//----------------------------------------------------------
+// Entity(生物や植物の基底クラス)
+//----------------------------------------------------------
+enum class EntityKind : uint8_t {
+    Plant    = 0,
+    Creature = 1
+};
+
+//   描画用の状態は持たない (色と半径だけ。形状は描画側で作る)
+class Entity {
+public:
+    Entity(EntityKind k, float r, sf::Color c) : radius(r), color(c), kind(k) {}
+    virtual ~Entity() = default;
+    virtual void update(float deltaTime) = 0;
+    virtual sf::Vector2f getPosition() const = 0;
+    virtual bool isAlive() const = 0;
+    virtual void onEaten() = 0;
+
+    EntityKind getKind() const       { return kind; }
+    sf::Color  getColor() const      { return color; }
+    float getCollisionRadius() const { return radius; }
+
+    // EntityList が付与する通し番号 (コマンドの適用順を決めるのに使う)
+    uint64_t id = 0;
+
+    // EntityList 内の位置 (swap-and-pop で移動したら付け替える)
+    int  listIndex = -1;
+    bool removalQueued = false;
+
+    // SweepAndPrune の前回の並び位置 (未登録なら -1)
+    int  sweepRank = -1;
+
+protected:
+    float      radius;
+    sf::Color  color;
+    EntityKind kind;
+};
+
+//----------------------------------------------------------
+// 死亡した Entity の削除方式
+//----------------------------------------------------------
+enum class RemovalStrategy {
+    EraseRemove, // 毎 tick 全体を erase-remove (従来どおり)
+    SwapAndPop,  // 死亡個体の位置に末尾を移して pop (死亡数に比例)
+    Tombstone    // 死亡個体はそのまま残し、一定割合を超えたらまとめて詰める
+};
+
+//----------------------------------------------------------
+// Entityコンテナ
+//   死亡した Entity は markDead() で登録し、removeDead() で削除方式に従って取り除く
+//----------------------------------------------------------
+class EntityList {
+public:
+    typedef std::vector<std::shared_ptr<Entity>>::iterator       iterator;
+    typedef std::vector<std::shared_ptr<Entity>>::const_iterator const_iterator;
+
+    void setStrategy(RemovalStrategy s) {
+        strategy = s;
+    }
+
+    // Tombstone 方式で詰め直すときの死亡個体の割合
+    void setTombstoneRatio(float r) {
+        tombstoneRatio = r;
+    }
+
+    void push_back(std::shared_ptr<Entity> e) {
+        e->id = nextId++;
+        e->listIndex = (int)items.size();
+        e->removalQueued = false;
+        items.push_back(std::move(e));
+    }
+
+    // extra 個分の追加に備えて確保
+    void reserve(size_t extra) {
+        size_t n = items.size() + extra;
+        if(n > items.capacity()) {
+            items.reserve(std::max(n, items.capacity() * 2));
+        }
+    }
+
+    // 末尾の n 個分の位置と通し番号をまとめて確保する
+    //   確保した位置へは place() で書き込む (位置が重ならなければ別スレッドから同時に呼べる)
+    //   通し番号は位置の順に振るので、push_back を n 回呼んだのと同じになる
+    struct Claim {
+        size_t   first;     // 先頭の位置
+        uint64_t firstId;   // 先頭の通し番号
+    };
+
+    Claim claim(size_t n) {
+        Claim c = { items.size(), nextId };
+        reserve(n);
+        items.resize(items.size() + n);
+        nextId += n;
+        return c;
+    }
+
+    // claim() で確保した i 番目の位置に置く
+    void place(const Claim& c, size_t i, std::shared_ptr<Entity> e) {
+        e->id = c.firstId + i;
+        e->listIndex = (int)(c.first + i);
+        e->removalQueued = false;
+        items[c.first + i] = std::move(e);
+    }
+
+    iterator begin()             { return items.begin(); }
+    iterator end()               { return items.end(); }
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const   { return items.end(); }
+    size_t size() const          { return items.size(); }
+    const std::shared_ptr<Entity>& operator[](size_t i) const { return items[i]; }
+
+    // 死亡を登録 (同じ Entity を2回登録しても1回分として扱う)
+    void markDead(Entity* e) {
+        if(e->removalQueued) return;
+        e->removalQueued = true;
+        dead.push_back(e);
+    }
+
+    // 墓標として残っている (まだ取り除いていない) 死亡個体の数
+    size_t tombstoneCount() const {
+        return tombstones;
+    }
+
+    void removeDead() {
+        switch(strategy) {
+            case RemovalStrategy::SwapAndPop: {
+                for(Entity* e : dead) {
+                    int i = e->listIndex;
+                    if(i != (int)items.size() - 1) {
+                        items[i] = std::move(items.back());
+                        items[i]->listIndex = i;
+                    }
+                    items.pop_back(); // ここで e は破棄される
+                }
+                dead.clear();
+            } break;
+            case RemovalStrategy::Tombstone: {
+                tombstones += dead.size();
+                dead.clear();
+                if(tombstones > MIN_TOMBSTONES && (float)tombstones > tombstoneRatio * (float)items.size()) {
+                    compact();
+                }
+            } break;
+            case RemovalStrategy::EraseRemove:
+            default: {
+                dead.clear();
+                compact();
+            } break;
+        }
+    }
+
+private:
+    // 生存している Entity だけを順序を保って詰める
+    void compact() {
+        items.erase(
+            std::remove_if(items.begin(), items.end(),
+                [](const std::shared_ptr<Entity>& e){ return !e->isAlive(); }),
+            items.end()
+        );
+        for(size_t i=0; i<items.size(); i++) {
+            items[i]->listIndex = (int)i;
+        }
+        tombstones = 0;
+    }
+
+    std::vector<std::shared_ptr<Entity>> items;
+    std::vector<Entity*> dead;   // この tick に死亡した Entity
+    // 割合だけで判定すると個体数が少ない時 (数十体) は数体死ぬたびに全体を詰め直し、
+    // 1 回あたり O(n) の compact が毎 tick 走って EraseRemove と変わらなくなる
+    // 64 個なら走査で読み飛ばす分は既定の個体数 (数百体) に比べて小さく、
+    // 詰め直し 1 回のコストを少なくとも 64 体の死亡に分けて払える
+    static const size_t MIN_TOMBSTONES = 64;
+    RemovalStrategy strategy = RemovalStrategy::SwapAndPop;
+    float  tombstoneRatio = 0.25f;
+    size_t tombstones = 0;
+    uint64_t nextId = 1;
+};
+
+//----------------------------------------------------------
+// Plant(植物: 動かない)
+//----------------------------------------------------------
+class Plant : public Entity {
+private:
+    sf::Vector2f position;
+    bool alive;
+public:
+    Plant(sf::Vector2f pos, float radius = 10.f, sf::Color color = sf::Color(120, 200, 120))
+        : Entity(EntityKind::Plant, radius, color), position(pos), alive(true)
+    {
+    }
+
+    void update(float /*deltaTime*/) override {
+        // 動かない
+    }
+
+    sf::Vector2f getPosition() const override {
+        return position;
+    }
+
+    bool isAlive() const override {
+        return alive;
+    }
+
+    void onEaten() override {
+        alive = false;
+    }
+};
+
+//----------------------------------------------------------
+// 行動ごとの運動 (1 tick 分)
+//   move : 前進するなら 1
+//   cosT / sinT : 向きベクトルの回転量 (旋回しないなら 1, 0)
+//----------------------------------------------------------
+struct ActionMotion {
+    static const int MAX_ACTIONS = 8;
+    float move[MAX_ACTIONS];
+    float cosT[MAX_ACTIONS];
+    float sinT[MAX_ACTIONS];
+};
+
+//----------------------------------------------------------
+// 餓死記録 (代謝パスの出力。学習ステージが最終報酬の計算に使う)
+//----------------------------------------------------------
+struct StarvedRecord {
+    int   slot;           // BodyStore のスロット
+    int   offspringCount; // 産んだ子孫の数
+    float lifetime;       // 生存時間 (秒)
+};
+
+//----------------------------------------------------------
+// Creature の位置・向き・速度・代謝 (SoA)
+//   向きは単位ベクトル (hx, hy) で持ち、三角関数は旋回量の計算 (tick ごとに1回) だけ
+//   空きスロットは action = STOP_ACTION, speed = 0, alive = 0 なので
+//   移動パス・代謝パスで何も起きない
+//----------------------------------------------------------
+struct BodyStore {
+    static const int32_t STOP_ACTION = 3;
+
+    std::vector<float>   x, y;     // 位置
+    std::vector<float>   hx, hy;   // 向き (単位ベクトル)
+    std::vector<float>   speed;
+    std::vector<int32_t> action;   // この tick の行動
+
+    std::vector<int32_t> alive;    // 生存フラグ (0 / -1: SIMD マスクとしてそのまま使う)
+    std::vector<float>   energy;
+    std::vector<float>   lifetime;       // 生存時間 (秒)
+    std::vector<float>   coolDown;       // 繁殖クールダウン
+    std::vector<int32_t> offspringCount; // 産んだ子孫の数
+    std::vector<Entity*> owner;          // スロットの持ち主
+
+    int allocate(Entity* e, sf::Vector2f pos, float directionDeg, float spd, float initialEnergy) {
+        int slot = claim();
+        assign(slot, e, pos, directionDeg, spd, initialEnergy);
+        return slot;
+    }
+
+    // 空きスロットを1つ取る (中身は assign() で埋める)
+    //   出生バッチではスロットを直列に取っておき、assign() を並列に呼ぶ
+    int claim() {
+        int slot;
+        if(!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = (int)x.size();
+            x.push_back(0.f); y.push_back(0.f);
+            hx.push_back(1.f); hy.push_back(0.f);
+            speed.push_back(0.f);
+            action.push_back(STOP_ACTION);
+            alive.push_back(0);
+            energy.push_back(0.f);
+            lifetime.push_back(0.f);
+            coolDown.push_back(0.f);
+            offspringCount.push_back(0);
+            owner.push_back(nullptr);
+        }
+        return slot;
+    }
+
+    // claim() で取ったスロットを初期化 (スロットが違えば別スレッドから呼べる)
+    void assign(int slot, Entity* e, sf::Vector2f pos, float directionDeg, float spd, float initialEnergy) {
+        float rad = directionDeg * 3.14159f / 180.f;
+        x[slot]  = pos.x;
+        y[slot]  = pos.y;
+        hx[slot] = std::cos(rad);
+        hy[slot] = std::sin(rad);
+        speed[slot]  = spd;
+        action[slot] = STOP_ACTION;
+        alive[slot]  = -1;
+        energy[slot]   = initialEnergy;
+        lifetime[slot] = 0.f;
+        coolDown[slot] = 0.f;
+        offspringCount[slot] = 0;
+        owner[slot] = e;
+    }
+
+    void release(int slot) {
+        speed[slot]  = 0.f;
+        action[slot] = STOP_ACTION;
+        alive[slot]  = 0;
+        owner[slot]  = nullptr;
+        freeSlots.push_back(slot);
+    }
+
+    int capacity() const {
+        return (int)x.size();
+    }
+
+    // 出生バーストの前に extra 個分の空きを確保 (途中で再確保が起きないように)
+    void reserve(size_t extra) {
+        if(extra <= freeSlots.size()) return;
+        size_t n = x.size() + (extra - freeSlots.size());
+        if(n <= x.capacity()) return;
+        n = std::max(n, x.capacity() * 2);   // 毎 tick 再確保しないよう倍々で広げる
+        x.reserve(n); y.reserve(n);
+        hx.reserve(n); hy.reserve(n);
+        speed.reserve(n);
+        action.reserve(n);
+        alive.reserve(n);
+        energy.reserve(n);
+        lifetime.reserve(n);
+        coolDown.reserve(n);
+        offspringCount.reserve(n);
+        owner.reserve(n);
+    }
+
+    // 全スロットの行動をリセット (行動しない個体は停止扱い)
+    void clearActions() {
+        std::fill(action.begin(), action.end(), STOP_ACTION);
+    }
+
+    // 移動 + 旋回 + 画面端での反射を全個体まとめて実行
+    void integrate(float deltaTime, const ActionMotion& m) {
+        int n = capacity();
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 dt    = _mm_set1_ps(deltaTime);
+        const __m128 zero  = _mm_setzero_ps();
+        const __m128 maxX  = _mm_set1_ps(WORLD_WIDTH);
+        const __m128 maxY  = _mm_set1_ps(WORLD_HEIGHT);
+        const __m128 sign  = _mm_set1_ps(-0.f);
+        const __m128 half  = _mm_set1_ps(0.5f);
+        const __m128 three = _mm_set1_ps(3.f);
+        for(; i + 4 <= n; i += 4) {
+            const int32_t* a = &action[i];
+            __m128 mv = _mm_setr_ps(m.move[a[0]], m.move[a[1]], m.move[a[2]], m.move[a[3]]);
+            __m128 c  = _mm_setr_ps(m.cosT[a[0]], m.cosT[a[1]], m.cosT[a[2]], m.cosT[a[3]]);
+            __m128 sn = _mm_setr_ps(m.sinT[a[0]], m.sinT[a[1]], m.sinT[a[2]], m.sinT[a[3]]);
+
+            __m128 px = _mm_loadu_ps(&x[i]);
+            __m128 py = _mm_loadu_ps(&y[i]);
+            __m128 vx = _mm_loadu_ps(&hx[i]);
+            __m128 vy = _mm_loadu_ps(&hy[i]);
+
+            // 前進
+            __m128 step = _mm_mul_ps(_mm_mul_ps(mv, _mm_loadu_ps(&speed[i])), dt);
+            px = _mm_add_ps(px, _mm_mul_ps(vx, step));
+            py = _mm_add_ps(py, _mm_mul_ps(vy, step));
+
+            // 旋回 (回転後に 1 回の Newton 反復で長さを 1 に戻す)
+            __m128 rx = _mm_sub_ps(_mm_mul_ps(vx, c), _mm_mul_ps(vy, sn));
+            __m128 ry = _mm_add_ps(_mm_mul_ps(vx, sn), _mm_mul_ps(vy, c));
+            __m128 len2 = _mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry));
+            __m128 k = _mm_mul_ps(half, _mm_sub_ps(three, len2));
+            rx = _mm_mul_ps(rx, k);
+            ry = _mm_mul_ps(ry, k);
+
+            // 画面外に出ないようバウンド (はみ出した辺の数が奇数なら反転)
+            __m128 ox0 = _mm_cmplt_ps(px, zero);
+            __m128 ox1 = _mm_cmpgt_ps(px, maxX);
+            __m128 oy0 = _mm_cmplt_ps(py, zero);
+            __m128 oy1 = _mm_cmpgt_ps(py, maxY);
+            __m128 flip = _mm_xor_ps(_mm_xor_ps(ox0, ox1), _mm_xor_ps(oy0, oy1));
+            px = _mm_min_ps(_mm_max_ps(px, zero), maxX);
+            py = _mm_min_ps(_mm_max_ps(py, zero), maxY);
+            rx = _mm_xor_ps(rx, _mm_and_ps(flip, sign));
+            ry = _mm_xor_ps(ry, _mm_and_ps(flip, sign));
+
+            _mm_storeu_ps(&x[i], px);
+            _mm_storeu_ps(&y[i], py);
+            _mm_storeu_ps(&hx[i], rx);
+            _mm_storeu_ps(&hy[i], ry);
+        }
+#endif
+        for(; i < n; i++) {
+            int a = action[i];
+            float step = m.move[a] * speed[i] * deltaTime;
+            float px = x[i] + hx[i] * step;
+            float py = y[i] + hy[i] * step;
+            float rx = hx[i] * m.cosT[a] - hy[i] * m.sinT[a];
+            float ry = hx[i] * m.sinT[a] + hy[i] * m.cosT[a];
+            float k = 0.5f * (3.f - (rx*rx + ry*ry));
+            rx *= k;
+            ry *= k;
+            bool flip = false;
+            if (px < 0.f)          { px = 0.f;          flip = !flip; }
+            if (px > WORLD_WIDTH)  { px = WORLD_WIDTH;  flip = !flip; }
+            if (py < 0.f)          { py = 0.f;          flip = !flip; }
+            if (py > WORLD_HEIGHT) { py = WORLD_HEIGHT; flip = !flip; }
+            if (flip) { rx = -rx; ry = -ry; }
+            x[i] = px;  y[i] = py;
+            hx[i] = rx; hy[i] = ry;
+        }
+    }
+
+    // 代謝 (寿命加算・エネルギー消費・餓死判定・クールダウン) を全個体まとめて実行
+    //   この tick で餓死した個体は alive = 0 にして starved に追加する
+    void metabolize(float deltaTime, float drainRate, std::vector<StarvedRecord>& starved) {
+        starved.clear();
+        int n = capacity();
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 dt    = _mm_set1_ps(deltaTime);
+        const __m128 drain = _mm_set1_ps(deltaTime * drainRate);
+        const __m128 zero  = _mm_setzero_ps();
+        for(; i + 4 <= n; i += 4) {
+            __m128 live = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&alive[i])));
+            __m128 lt = _mm_loadu_ps(&lifetime[i]);
+            __m128 en = _mm_loadu_ps(&energy[i]);
+            __m128 cd = _mm_loadu_ps(&coolDown[i]);
+
+            lt = _mm_add_ps(lt, _mm_and_ps(live, dt));
+            en = _mm_sub_ps(en, _mm_and_ps(live, drain));
+
+            __m128 dead = _mm_and_ps(live, _mm_cmple_ps(en, zero));
+            __m128 stillLive = _mm_andnot_ps(dead, live);
+            // クールダウンは生きている個体で残りがある場合のみ減らす
+            cd = _mm_sub_ps(cd, _mm_and_ps(_mm_and_ps(stillLive, _mm_cmpgt_ps(cd, zero)), dt));
+
+            _mm_storeu_ps(&lifetime[i], lt);
+            _mm_storeu_ps(&energy[i], en);
+            _mm_storeu_ps(&coolDown[i], cd);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&alive[i]), _mm_castps_si128(stillLive));
+
+            int bits = _mm_movemask_ps(dead);
+            while(bits) {
+                int lane = __builtin_ctz(bits);
+                bits &= bits - 1;
+                int k = i + lane;
+                starved.push_back(StarvedRecord{ k, offspringCount[k], lifetime[k] });
+            }
+        }
+#endif
+        for(; i < n; i++) {
+            if(!alive[i]) continue;
+            lifetime[i] += deltaTime;
+            energy[i]   -= deltaTime * drainRate;
+            if(energy[i] <= 0.f) {
+                alive[i] = 0;
+                starved.push_back(StarvedRecord{ i, offspringCount[i], lifetime[i] });
+                continue;
+            }
+            if(coolDown[i] > 0.f) coolDown[i] -= deltaTime;
+        }
+    }
+
+private:
+    std::vector<int> freeSlots;
+};
+
+const int32_t BodyStore::STOP_ACTION;
+
+//----------------------------------------------------------
+// tick 内のコマンド
+//   各フェーズはワールドを直接書き換えず、死亡・捕食 (エネルギー移動)・出生を記録する
+//----------------------------------------------------------
+
+// 餓死 (代謝パスで判定済み。最終報酬と削除登録を行う)
+struct StarveCommand {
+    Entity*       victim;
+    StarvedRecord record;
+};
+
+// 捕食 (prey が死亡し、predator にエネルギーと報酬が入る)
+struct EatCommand {
+    Entity* predator;
+    Entity* prey;
+    float   energy;       // 得られるエネルギー
+    float   reward;       // 正の報酬
+    float   poisonDamage; // 毒によるエネルギー減少
+};
+
+// 出生 (parentA == parentB なら単独増殖)
+struct BirthCommand {
+    Entity* parentA;
+    Entity* parentB;
+};
+
+// ワーカーごとの記録領域
+struct CommandSegment {
+    std::vector<StarveCommand> starves;
+    std::vector<EatCommand>    eats;
+    std::vector<BirthCommand>  births;
+
+    void clear() {
+        starves.clear();
+        eats.clear();
+        births.clear();
+    }
+};
+
+//----------------------------------------------------------
+// コマンドバッファ
+//   記録はワーカーごとのセグメントに分け (ロック不要)、
+//   tick 末に全セグメントを Entity ID 順に整列してから適用するので
+//   記録した順序やスレッドの実行順に結果が依存しない
+//----------------------------------------------------------
+class CommandBuffer {
+public:
+    CommandBuffer() : segments(1) {}
+
+    void setWorkerCount(int n) {
+        segments.resize(std::max(1, n));
+    }
+
+    int workerCount() const {
+        return (int)segments.size();
+    }
+
+    CommandSegment& segment(int worker = 0) {
+        return segments[worker];
+    }
+
+    // 全セグメントを結合して決定的な順序に並べ、セグメントを空にする
+    void gather(std::vector<StarveCommand>& starves,
+                std::vector<EatCommand>& eats,
+                std::vector<BirthCommand>& births) {
+        // セグメントごとの書き込み位置を累積和で決めてから1回で確保して写す
+        size_t ns = 0, ne = 0, nb = 0;
+        for(const CommandSegment& seg : segments) {
+            ns += seg.starves.size();
+            ne += seg.eats.size();
+            nb += seg.births.size();
+        }
+        starves.resize(ns);
+        eats.resize(ne);
+        births.resize(nb);
+        ns = ne = nb = 0;
+        for(CommandSegment& seg : segments) {
+            std::copy(seg.starves.begin(), seg.starves.end(), starves.begin() + ns);
+            std::copy(seg.eats.begin(), seg.eats.end(), eats.begin() + ne);
+            std::copy(seg.births.begin(), seg.births.end(), births.begin() + nb);
+            ns += seg.starves.size();
+            ne += seg.eats.size();
+            nb += seg.births.size();
+            seg.clear();
+        }
+        std::sort(starves.begin(), starves.end(),
+            [](const StarveCommand& a, const StarveCommand& b) {
+                return a.victim->id < b.victim->id;
+            });
+        // 同じ獲物を複数が狙った場合は ID の小さい捕食者が先
+        //   同じ組が2件ある (双方の接触判定から出る) 場合はエネルギーの大きい方が先
+        //   (近傍探索の方式で候補の順序が変わっても結果が変わらないように全順序にする)
+        std::sort(eats.begin(), eats.end(),
+            [](const EatCommand& a, const EatCommand& b) {
+                if(a.prey->id != b.prey->id) return a.prey->id < b.prey->id;
+                if(a.predator->id != b.predator->id) return a.predator->id < b.predator->id;
+                return a.energy > b.energy;
+            });
+        std::sort(births.begin(), births.end(),
+            [](const BirthCommand& a, const BirthCommand& b) {
+                if(a.parentA->id != b.parentA->id) return a.parentA->id < b.parentA->id;
+                return a.parentB->id < b.parentB->id;
+            });
+    }
+
+private:
+    std::vector<CommandSegment> segments;
+};
+
+//----------------------------------------------------------
+// 近傍候補の詰め合わせ (SoA)
+//   生存している Entity の位置・半径・攻撃力を連続配置し、
+//   1 個体 × 64 候補をまとめて判定できるようにする
+//   植物の攻撃力は -1 (= どの Creature から見ても「餌」)
+//   末尾に BLOCK 個の番兵を置くので、どの位置からでも 64 個読める
+//----------------------------------------------------------
+struct NeighborPack {
+    static const size_t BLOCK = 64;
+
+    std::vector<float>   x, y, radius, attack;
+    std::vector<Entity*> owner;
+    float maxRadius = 0.f;
+
+    void clear() {
+        count = 0;
+        maxRadius = 0.f;
+        x.clear(); y.clear(); radius.clear(); attack.clear();
+        owner.clear();
+    }
+
+    void push(Entity* e, float px, float py, float r, float atk) {
+        x.push_back(px);
+        y.push_back(py);
+        radius.push_back(r);
+        attack.push_back(atk);
+        owner.push_back(e);
+        maxRadius = std::max(maxRadius, r);
+        count++;
+    }
+
+    // 末尾に番兵を置く (push の後に1回呼ぶ)
+    void finalize() {
+        size_t padded = count + BLOCK;
+        x.resize(padded, 1e30f);
+        y.resize(padded, 1e30f);
+        radius.resize(padded, 0.f);
+        attack.resize(padded, 0.f);
+        owner.resize(padded, nullptr);
+    }
+
+    // order の順に並べ替える (scratch は作業領域)
+    void permute(const std::vector<uint32_t>& order, NeighborPack& scratch) {
+        scratch.clear();
+        for(uint32_t i : order) {
+            scratch.push(owner[i], x[i], y[i], radius[i], attack[i]);
+        }
+        scratch.finalize();
+        std::swap(x, scratch.x);
+        std::swap(y, scratch.y);
+        std::swap(radius, scratch.radius);
+        std::swap(attack, scratch.attack);
+        std::swap(owner, scratch.owner);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // 先頭 n 個 (n <= BLOCK) のビット
+    static uint64_t lowMask(size_t n) {
+        return n >= BLOCK ? ~0ull : ((1ull << n) - 1);
+    }
+
+private:
+    size_t count = 0;
+};
+
+// 判定する側の個体
+struct NeighborProbe {
+    float x, y;
+    float radius;
+    float senseRange2;
+    float attack;
+};
+
+// 64 候補分の判定結果 (ビット i が候補 start + i に対応)
+struct NeighborMasks {
+    uint64_t sense;      // 感知範囲内 (距離² <= senseRange²)
+    uint64_t collide;    // 接触 (距離 < 半径の和)
+    uint64_t food;       // 自分より攻撃力が低い (植物を含む)
+    uint64_t predator;   // 自分より攻撃力が高い
+};
+
+//----------------------------------------------------------
+// 近傍判定カーネル (AVX2: 8 候補ずつ / SSE2: 4 候補ずつ / スカラー)
+//   どの版も距離² = dx*dx + dy*dy を同じ順序で計算するので結果は一致する
+//----------------------------------------------------------
+inline NeighborMasks testNeighborBlockScalar(const NeighborPack& pack, size_t base, const NeighborProbe& p) {
+    NeighborMasks m = { 0, 0, 0, 0 };
+    for(size_t i=0; i<NeighborPack::BLOCK; i++) {
+        float dx = pack.x[base + i] - p.x;
+        float dy = pack.y[base + i] - p.y;
+        float d2 = dx*dx + dy*dy;
+        float rr = p.radius + pack.radius[base + i];
+        uint64_t bit = 1ull << i;
+        if(d2 <= p.senseRange2)          m.sense    |= bit;
+        if(d2 < rr*rr)                   m.collide  |= bit;
+        if(pack.attack[base + i] < p.attack) m.food     |= bit;
+        if(pack.attack[base + i] > p.attack) m.predator |= bit;
+    }
+    return m;
+}
+
+#if defined(__SSE2__)
+inline NeighborMasks testNeighborBlockSSE2(const NeighborPack& pack, size_t base, const NeighborProbe& p) {
+    NeighborMasks m = { 0, 0, 0, 0 };
+    const __m128 px  = _mm_set1_ps(p.x);
+    const __m128 py  = _mm_set1_ps(p.y);
+    const __m128 pr  = _mm_set1_ps(p.radius);
+    const __m128 sr2 = _mm_set1_ps(p.senseRange2);
+    const __m128 atk = _mm_set1_ps(p.attack);
+    for(size_t i=0; i<NeighborPack::BLOCK; i+=4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&pack.x[base + i]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&pack.y[base + i]), py);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 rr = _mm_add_ps(pr, _mm_loadu_ps(&pack.radius[base + i]));
+        __m128 a  = _mm_loadu_ps(&pack.attack[base + i]);
+        m.sense    |= (uint64_t)_mm_movemask_ps(_mm_cmple_ps(d2, sr2))            << i;
+        m.collide  |= (uint64_t)_mm_movemask_ps(_mm_cmplt_ps(d2, _mm_mul_ps(rr, rr))) << i;
+        m.food     |= (uint64_t)_mm_movemask_ps(_mm_cmplt_ps(a, atk))             << i;
+        m.predator |= (uint64_t)_mm_movemask_ps(_mm_cmpgt_ps(a, atk))             << i;
+    }
+    return m;
+}
+#endif
+
+#if defined(EVO_HAS_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+inline NeighborMasks testNeighborBlockAVX2(const NeighborPack& pack, size_t base, const NeighborProbe& p) {
+    NeighborMasks m = { 0, 0, 0, 0 };
+    const __m256 px  = _mm256_set1_ps(p.x);
+    const __m256 py  = _mm256_set1_ps(p.y);
+    const __m256 pr  = _mm256_set1_ps(p.radius);
+    const __m256 sr2 = _mm256_set1_ps(p.senseRange2);
+    const __m256 atk = _mm256_set1_ps(p.attack);
+    for(size_t i=0; i<NeighborPack::BLOCK; i+=8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&pack.x[base + i]), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&pack.y[base + i]), py);
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 rr = _mm256_add_ps(pr, _mm256_loadu_ps(&pack.radius[base + i]));
+        __m256 a  = _mm256_loadu_ps(&pack.attack[base + i]);
+        m.sense    |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(d2, sr2, _CMP_LE_OQ)) << i;
+        m.collide  |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(rr, rr), _CMP_LT_OQ)) << i;
+        m.food     |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(a, atk, _CMP_LT_OQ)) << i;
+        m.predator |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(a, atk, _CMP_GT_OQ)) << i;
+    }
+    return m;
+}
+#endif
+
+typedef NeighborMasks (*NeighborKernel)(const NeighborPack&, size_t, const NeighborProbe&);
+
+// 実行中の CPU で使える一番速い版を選ぶ (初回のみ判定)
+inline NeighborKernel neighborKernel() {
+    static const NeighborKernel kernel = []() -> NeighborKernel {
+#if defined(EVO_HAS_AVX2_DISPATCH)
+        if(__builtin_cpu_supports("avx2")) return &testNeighborBlockAVX2;
+#endif
+#if defined(__SSE2__)
+        return &testNeighborBlockSSE2;
+#else
+        return &testNeighborBlockScalar;
+#endif
+    }();
+    return kernel;
+}
+
+// 立っているビットの位置を下位から順に取り出す
+inline int popLowestBit(uint64_t& bits) {
+    int i = __builtin_ctzll(bits);
+    bits &= bits - 1;
+    return i;
+}
+
+//----------------------------------------------------------
+// 近傍探索の方式
+//----------------------------------------------------------
+enum class SpatialMode {
+    BruteForce,   // 全候補を判定 (既定。このシミュレーションの通常の個体数ではこちらが速い)
+    Grid          // 多段グリッド (HierarchicalGrid。候補が GRID_MIN_COUNT 以上の時だけ作る)
+};
+
+//----------------------------------------------------------
+// 衝突判定の方式
+//----------------------------------------------------------
+enum class CollisionMode {
+    Query,          // 近傍探索 (SpatialMode) で各個体の接触候補を引く
+    SweepAndPrune   // x 軸の Sweep and Prune で接触ペアを列挙する
+};
+
+//----------------------------------------------------------
+// 感知のキャッシュ
+//   前回の観測から maxAge tick 未満で、移動量が moveLimit 以下で、
+//   (cellCheck なら) 周囲のセルに出入りが無ければ前回の結果を使い回す (CellStamps)
+//   maxAge = 1 なら毎回感知し直す (既定。従来と同じ結果)
+//----------------------------------------------------------
+struct SenseCacheConfig {
+    int   maxAge    = 1;
+    float moveLimit = 8.f;
+    bool  cellCheck = true;
+};
+
+//----------------------------------------------------------
+// 多段グリッド (暗黙の四分木)
+//   最も細かいセル (16px) の Morton 順に NeighborPack を並べ替えておくと、
+//   2^L 倍の粗いセルも Morton 順で連続した区間になる
+//   問い合わせ半径 r に対してセルが r 以上になる段を選ぶので、
+//   感知範囲が 20 でも 300 でも見るセルは高々 3×3 (区間の連結で更に減る)
+//----------------------------------------------------------
+class HierarchicalGrid {
+public:
+    static const int   SIDE_BITS = 6;                    // 最も細かい段は 64×64 セル
+    static const int   SIDE      = 1 << SIDE_BITS;
+    static const int   LEVELS    = SIDE_BITS + 1;        // 16px, 32px, ..., 1024px
+    static constexpr float FINE_CELL = 16.f;
+
+    // pack をセル順に並べ替える
+    //   セルの開始位置は並べた codes を二分探索して求める
+    //   (4096 セル分の表を毎回作ると、個体数が少ない時に並べ替えより重くなる)
+    void build(NeighborPack& pack) {
+        const size_t n = pack.size();
+        keyed.resize(n);
+        for(size_t i=0; i<n; i++) {
+            uint64_t code = morton(cellOf(pack.x[i]), cellOf(pack.y[i]));
+            keyed[i] = (code << 32) | i;   // 同じセル内は元の順序を保つ
+        }
+        std::sort(keyed.begin(), keyed.end());
+        codes.resize(n);
+        order.resize(n);
+        for(size_t i=0; i<n; i++) {
+            codes[i] = (uint32_t)(keyed[i] >> 32);
+            order[i] = (uint32_t)keyed[i];
+        }
+        pack.permute(order, scratch);
+    }
+
+    // (x, y) から半径 r の正方形に掛かるセルの区間 [begin, end) を f に渡す
+    // f が false を返したら中断
+    template <class F>
+    void query(float x, float y, float r, F&& f) const {
+        const Region g = region(x, y, r);
+
+        // Morton 順に並べてから近い区間を連結する
+        //   間の候補が 1 ブロック (64) 未満なら、別々にカーネルにかけるより
+        //   まとめて 1 回で判定した方が速い (範囲外の候補はカーネルが弾く)
+        uint32_t bases[9];
+        int count = 0;
+        for(int cy=g.y0; cy<=g.y1; cy++) {
+            for(int cx=g.x0; cx<=g.x1; cx++) {
+                bases[count++] = morton(cx << g.level, cy << g.level);
+            }
+        }
+        for(int i=1; i<count; i++) {   // 高々 9 個なので挿入ソート
+            uint32_t v = bases[i];
+            int j = i;
+            for(; j > 0 && bases[j - 1] > v; j--) bases[j] = bases[j - 1];
+            bases[j] = v;
+        }
+        const uint32_t span = 1u << (2 * g.level);
+        uint32_t begin = 0, end = 0;
+        for(int i=0; i<count; i++) {
+            uint32_t b = cellStart(bases[i]);
+            uint32_t e = cellStart(bases[i] + span);
+            if(b == e) continue;
+            if(begin != end && b - end < (uint32_t)NeighborPack::BLOCK) {
+                end = e;
+                continue;
+            }
+            if(begin != end && !f((size_t)begin, (size_t)end)) return;
+            begin = b;
+            end   = e;
+        }
+        if(begin != end) f((size_t)begin, (size_t)end);
+    }
+
+private:
+    friend class CellStamps;
+
+    std::vector<uint64_t> keyed;
+    std::vector<uint32_t> codes, order;
+    NeighborPack scratch;
+
+    // Morton 番号が code 以上になる最初の位置
+    uint32_t cellStart(uint32_t code) const {
+        return (uint32_t)(std::lower_bound(codes.begin(), codes.end(), code) - codes.begin());
+    }
+
+    // 半径 r に合う段と、その段で掛かるセルの範囲
+    struct Region {
+        int level;
+        int x0, x1, y0, y1;
+    };
+
+    static Region region(float x, float y, float r) {
+        Region g;
+        g.level = 0;
+        while(g.level < LEVELS - 1 && (FINE_CELL * (1 << g.level)) < r) g.level++;
+        const int side = SIDE >> g.level;
+        const float cell = FINE_CELL * (1 << g.level);
+        g.x0 = clampCell((int)std::floor((x - r) / cell), side);
+        g.x1 = clampCell((int)std::floor((x + r) / cell), side);
+        g.y0 = clampCell((int)std::floor((y - r) / cell), side);
+        g.y1 = clampCell((int)std::floor((y + r) / cell), side);
+        return g;
+    }
+
+    static int cellOf(float v) {
+        return clampCell((int)(v / FINE_CELL), SIDE);
+    }
+
+    static int clampCell(int c, int side) {
+        return c < 0 ? 0 : (c >= side ? side - 1 : c);
+    }
+
+    // ビットを交互に並べる (x が下位)
+    static uint32_t morton(int cx, int cy) {
+        return spreadBits((uint32_t)cx) | (spreadBits((uint32_t)cy) << 1);
+    }
+
+    // 下位 8bit を1つおきに広げる (abcd → 0a0b0c0d)
+    static uint32_t spreadBits(uint32_t v) {
+        v = (v | (v << 4)) & 0x0f0fu;
+        v = (v | (v << 2)) & 0x3333u;
+        v = (v | (v << 1)) & 0x5555u;
+        return v;
+    }
+};
+
+//----------------------------------------------------------
+// セルごとの顔ぶれの印 (感知キャッシュの判定用)
+//   ワールド全体の生存 Entity から、HierarchicalGrid と同じ段のセルごとに
+//   通し番号を混ぜた値の和を持つ。セルに出入りがあった時だけ値が変わり、
+//   近傍索引の方式 (総当たり / グリッド) や帯の分け方には左右されない
+//----------------------------------------------------------
+class CellStamps {
+public:
+    typedef HierarchicalGrid Grid;
+
+    // 前回の寄与を引いてから今回の寄与を足す (毎回全セルを作り直すより、個体数に比例する分だけ安い)
+    void build(const EntityList& entities) {
+        if(stamps[0].empty()) {
+            for(int level=0; level<Grid::LEVELS; level++) {
+                const int side = Grid::SIDE >> level;
+                stamps[level].assign((size_t)side * side, 0u);
+            }
+        }
+        for(const Contribution& c : placed) add(c, 0u - c.value);
+        placed.clear();
+        for(const auto& e : entities) {
+            if(!e->isAlive()) continue;
+            sf::Vector2f pos = e->getPosition();
+            placed.push_back(Contribution{ (uint16_t)Grid::cellOf(pos.x), (uint16_t)Grid::cellOf(pos.y), mix(e->id) });
+        }
+        for(const Contribution& c : placed) add(c, c.value);
+    }
+
+    // (x, y) から半径 r の問い合わせが見るセルの印をまとめた値
+    //   変わっていなければ周囲の顔ぶれも変わっていない (セル内の移動は見ない)
+    uint32_t signature(float x, float y, float r) const {
+        const Grid::Region g = Grid::region(x, y, r);
+        const int side = Grid::SIDE >> g.level;
+        uint32_t h = 2166136261u;   // FNV-1a
+        for(int cy=g.y0; cy<=g.y1; cy++) {
+            for(int cx=g.x0; cx<=g.x1; cx++) {
+                const uint32_t cell = (uint32_t)(cy * side + cx);
+                h = (h ^ cell) * 16777619u;
+                h = (h ^ stamps[g.level][cell]) * 16777619u;
+            }
+        }
+        return h;
+    }
+
+private:
+    // 最も細かい段のセルと、そこに足した値
+    struct Contribution {
+        uint16_t cx, cy;
+        uint32_t value;
+    };
+
+    std::vector<uint32_t>     stamps[Grid::LEVELS];   // 段ごとのセルの印 (粗い段は細かい段の和)
+    std::vector<Contribution> placed;                 // 前回 build で足した分
+
+    void add(const Contribution& c, uint32_t value) {
+        for(int level=0; level<Grid::LEVELS; level++) {
+            const int side = Grid::SIDE >> level;
+            stamps[level][(size_t)(c.cy >> level) * side + (c.cx >> level)] += value;
+        }
+    }
+
+    static uint32_t mix(uint64_t id) {
+        return (uint32_t)((id * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+};
+
+//----------------------------------------------------------
+// Sweep and Prune (x 軸)
+//   左端 (x - 半径) で並べた列を tick をまたいで持ち越し、挿入ソートで並べ直す
+//   個体は1 tick にわずかしか動かないのでほぼ整列済みで、並べ直しは O(n + 入れ替え数)
+//   固定サイズのセルと違い、餌の周りに密集しても候補が増えるのは重なっている範囲だけ
+//----------------------------------------------------------
+class SweepAndPrune {
+public:
+    // 接触している候補のペア (pack の添字、順不同で1回ずつ) を f(i, j) に渡す
+    template <class F>
+    void collide(const NeighborPack& pack, F&& f) {
+        const size_t n = pack.size();
+
+        // 前回の順位の位置に置き、初登場のものは末尾に回す
+        slots.assign(previousCount, NONE);
+        fresh.clear();
+        for(size_t i=0; i<n; i++) {
+            int rank = pack.owner[i]->sweepRank;
+            if(rank >= 0 && (size_t)rank < previousCount && slots[rank] == NONE) {
+                slots[rank] = (uint32_t)i;
+            } else {
+                fresh.push_back((uint32_t)i);
+            }
+        }
+        order.clear();
+        for(uint32_t i : slots) {
+            if(i != NONE) order.push_back(i);
+        }
+        order.insert(order.end(), fresh.begin(), fresh.end());
+
+        // 挿入ソート
+        keys.resize(n);
+        for(size_t k=0; k<n; k++) {
+            keys[k] = pack.x[order[k]] - pack.radius[order[k]];
+        }
+        for(size_t k=1; k<n; k++) {
+            float key = keys[k];
+            uint32_t idx = order[k];
+            size_t m = k;
+            for(; m > 0 && keys[m - 1] > key; m--) {
+                keys[m]  = keys[m - 1];
+                order[m] = order[m - 1];
+            }
+            keys[m]  = key;
+            order[m] = idx;
+        }
+        for(size_t k=0; k<n; k++) {
+            pack.owner[order[k]]->sweepRank = (int)k;
+        }
+        previousCount = n;
+
+        // 左から掃いて x 区間が重なる相手だけ円の接触を調べる (判定式はカーネルと同じ)
+        for(size_t a=0; a<n; a++) {
+            const uint32_t i = order[a];
+            const float right = pack.x[i] + pack.radius[i];
+            for(size_t b=a+1; b<n && keys[b] <= right; b++) {
+                const uint32_t j = order[b];
+                float dx = pack.x[j] - pack.x[i];
+                float dy = pack.y[j] - pack.y[i];
+                float rr = pack.radius[i] + pack.radius[j];
+                if(dx*dx + dy*dy < rr*rr) f((size_t)i, (size_t)j);
+            }
+        }
+    }
+
+private:
+    static const uint32_t NONE = 0xffffffffu;
+
+    std::vector<uint32_t> order, slots, fresh;
+    std::vector<float>    keys;
+    size_t                previousCount = 0;
+};
+const uint32_t SweepAndPrune::NONE;
+
+//----------------------------------------------------------
+// 近傍索引 (候補の詰め合わせ + 多段グリッド)
+//   ワールド全体で1つ、領域分割時は帯ごとに1つ (自分の帯 + のりしろ)
+//----------------------------------------------------------
+struct NeighborIndex {
+    NeighborPack     pack;
+    HierarchicalGrid grid;
+    bool             gridActive = false;   // この候補でグリッドを作ったか
+
+    // これより少ない候補ではグリッドを作らず全候補を走査する
+    //   800×600 のワールドに一様に置き、感知 (半径 50〜150) と接触の問い合わせを全個体から
+    //   1回ずつ行った計測で、作成込みの時間が全走査と並ぶのが約 1500 候補 (1024 では全走査が 1.4 倍速い)
+    //   感知範囲の広い個体はワールドの大半を覆う粗い段を引くので、グリッドの効きは個体数が多い時だけ
+    static const size_t GRID_MIN_COUNT = 24 * NeighborPack::BLOCK;
+
+    // 詰め終わった候補を確定する (Grid ならセル順に並べ替える)
+    void finish(SpatialMode mode) {
+        pack.finalize();
+        gridActive = mode == SpatialMode::Grid && pack.size() >= GRID_MIN_COUNT;
+        if(gridActive) grid.build(pack);
+    }
+
+    // probe から距離 range 以内に居るかもしれない候補を 64 個ずつカーネルにかけ、
+    // (開始位置, 有効ビット込みのマスク) を f に渡す (f が false を返したら中断)
+    template <class F>
+    void query(const NeighborProbe& probe, float range, F&& f) const {
+        const NeighborKernel kernel = neighborKernel();
+        auto scan = [&](size_t begin, size_t end) {
+            for(size_t start=begin; start<end; start+=NeighborPack::BLOCK) {
+                NeighborMasks m = kernel(pack, start, probe);
+                uint64_t valid = NeighborPack::lowMask(end - start);
+                m.sense &= valid;
+                m.collide &= valid;
+                if(!f(start, m)) return false;
+            }
+            return true;
+        };
+        if(gridActive) {
+            grid.query(probe.x, probe.y, range, scan);
+        } else {
+            scan(0, pack.size());
+        }
+    }
+};
+
+//----------------------------------------------------------
+// ワールド (Creature から参照する共有データ)
+//   Creature の破棄時に qTables / bodies を参照するため entities を最後に宣言する
+//----------------------------------------------------------
+template <class QStore>
+struct BasicWorld {
+    SimParams     params;
+    uint64_t      tick = 0;
+    LineageLog    lineage;
+    QStore        qTables;
+    BodyStore     bodies;
+    CommandBuffer commands;
+    NeighborIndex neighbors;   // この tick の近傍候補 (Simulation が各フェーズの前に詰め直す)
+    SpatialMode   spatialMode = SpatialMode::BruteForce;
+    SenseCacheConfig senseCache;
+    CellStamps    cells;       // 感知キャッシュの判定用 (cellCheck の時だけ観測の前に作り直す)
+
+    // 領域分割時の帯ごとの近傍索引 (空なら neighbors を使う)
+    //   帯 k は x が [regionBounds[k-1], regionBounds[k]) の範囲
+    std::vector<NeighborIndex> regions;
+    std::vector<float>         regionBounds;
+
+    EntityList    entities;
+
+    // x の位置で引くべき近傍索引
+    //   帯の索引はのりしろ込みなので、帯の内側の点からの問い合わせは全体の索引と同じ候補を返す
+    const NeighborIndex& neighborsAt(float x) const {
+        if(regions.empty()) return neighbors;
+        size_t k = std::upper_bound(regionBounds.begin(), regionBounds.end(), x) - regionBounds.begin();
+        return regions[k];
+    }
+};
+
+//----------------------------------------------------------
+// 観測結果 (状態エンコーダへの入力)
+//----------------------------------------------------------
+struct Observation {
+    bool  foodNear;
+    bool  predatorNear;
+    float foodDist2;        // 最も近い餌までの2乗距離 (未検出なら感知範囲²)
+    float predatorDist2;    // 最も近い捕食者までの2乗距離
+    sf::Vector2f foodDir;   // 最も近い餌への相対位置
+    sf::Vector2f predatorDir;
+    float senseRange2;      // 感知範囲²
+    float energy;
+    float headingX;         // 向き (単位ベクトル)
+    float headingY;
+};
+
+//----------------------------------------------------------
+// 状態エンコーダ (コンパイル時に選択)
+//   NUM_STATES     : 状態数
+//   NEEDS_NEAREST  : 最寄りの対象の距離・方向が必要か
+//                    (false なら餌と捕食者を両方見つけた時点で走査を打ち切る)
+//   encode()       : Observation → 状態番号
+//   name()         : チェックポイントに記録する名前
+//----------------------------------------------------------
+
+// 餌が近いか / 捕食者が近いか の2bit (従来の4状態)
+struct NearFlagsEncoder {
+    static const int  NUM_STATES    = 4;
+    static const bool NEEDS_NEAREST = false;
+
+    static const char* name() { return "near-flags"; }
+
+    static int encode(const Observation& o) {
+        int s = 0;
+        if(o.foodNear)     s |= 1; // bit0
+        if(o.predatorNear) s |= 2; // bit1
+        return s; // 0..3
+    }
+};
+
+// 距離ビン (なし/遠い/近い) × 2種 × エネルギー (低/高) = 18状態
+struct DistanceBinEncoder {
+    static const int  NUM_STATES    = 3 * 3 * 2;
+    static const bool NEEDS_NEAREST = true;
+
+    static const char* name() { return "distance-bin"; }
+
+    static int distanceBin(bool found, float dist2, float range2) {
+        if(!found) return 0;
+        return (dist2 * 4.f < range2) ? 2 : 1; // 感知範囲の半分以内なら「近い」
+    }
+
+    static int encode(const Observation& o) {
+        int food = distanceBin(o.foodNear, o.foodDist2, o.senseRange2);
+        int pred = distanceBin(o.predatorNear, o.predatorDist2, o.senseRange2);
+        int hungry = (o.energy < 30.f) ? 1 : 0;
+        return (food * 3 + pred) * 2 + hungry;
+    }
+};
+
+// 方向セクタ (なし/前/左/右) × 2種 × エネルギー (低/高) = 32状態
+struct SectorEncoder {
+    static const int  NUM_STATES    = 4 * 4 * 2;
+    static const bool NEEDS_NEAREST = true;
+
+    static const char* name() { return "sector"; }
+
+    static int sector(bool found, sf::Vector2f d, float hx, float hy) {
+        if(!found) return 0;
+        float fwd  = d.x * hx + d.y * hy;
+        float side = hx * d.y - hy * d.x; // 正なら右手側 (y 軸が下向きのため)
+        if(fwd >= std::fabs(side)) return 1;
+        return (side < 0.f) ? 2 : 3;
+    }
+
+    static int encode(const Observation& o) {
+        int food = sector(o.foodNear, o.foodDir, o.headingX, o.headingY);
+        int pred = sector(o.predatorNear, o.predatorDir, o.headingX, o.headingY);
+        int hungry = (o.energy < 30.f) ? 1 : 0;
+        return (food * 4 + pred) * 2 + hungry;
+    }
+};
+
+//----------------------------------------------------------
+// 移住個体 (島モデルでワールド間を移動する Creature の中身)
+//----------------------------------------------------------
+struct Migrant {
+    Genes        genes;
+    sf::Color    color;
+    sf::Vector2f position;
+    int          generation;
+    int          lineage;
+    float        energy;
+    float        lifetime;
+    int32_t      offspringCount;
+    std::vector<float> q;   // Qテーブル (デコード済み)
+    uint64_t     sourceId;      // 移住元での ID (系統ログ用)
+    int          sourceIsland;  // 移住元の島番号
+};
+
+//----------------------------------------------------------
+// Creature(動物的な生物) + GA(Genes) + Q学習
+//   StateEncoder : 状態エンコーダ
+//   ActionCount  : 行動数 (4: 前進,左旋回,右旋回,停止 / 6: +左右の急旋回)
+//   QStorage     : Q値の格納形式
+//----------------------------------------------------------
+template <class StateEncoder, int ActionCount, class QStorage = FloatQStorage>
+class BasicCreature : public Entity {
+    static_assert(ActionCount == 4 || ActionCount == 6, "ActionCount must be 4 or 6");
+
+public:
+    typedef BasicQTableStore<StateEncoder::NUM_STATES, ActionCount, QStorage> QTableStore;
+    typedef BasicWorld<QTableStore> World;
+    typedef StateEncoder Encoder;
+
+private:
+    //------------------------------------------------------
+    // Q学習関連
+    //------------------------------------------------------
+    static const int NUM_STATES  = QTableStore::NUM_STATES;
+    static const int NUM_ACTIONS = QTableStore::NUM_ACTIONS;
+
+    //------------------------------------------------------
+    // 所属するワールド
+    //------------------------------------------------------
+    World* pWorld;
+
+    // Qテーブル本体は QTableStore 側に連続配置 (Q[s][a] = table[s*NUM_ACTIONS + a])
+    QTableStore* pQTables;
+    int qSlot;
+
+    float epsilon; // ε-greedy
+    float alpha;   // 学習率
+    float gamma;   // 割引率
+
+    int   currentState;
+    int   currentAction;
+
+    // 先に観測しておいた次状態 (領域分割時に帯ごとの並列観測で埋める)
+    int   preparedState;
+    bool  prepared;
+
+    // 前回の感知結果 (energy / heading 以外) と、その時の tick・位置
+    Observation sensed;
+    uint64_t    sensedTick;
+    float       sensedX, sensedY;
+    uint32_t    sensedSignature;
+
+    //------------------------------------------------------
+    // 遺伝子
+    //------------------------------------------------------
+    Genes genes;
+    int generation;
+    int lineage;    // 始祖の番号 (子は最初の親から引き継ぐ)
+
+    //------------------------------------------------------
+    // 物理関連
+    //------------------------------------------------------
+    // 位置・向き・速度・エネルギー・生存時間・子孫数などは World::bodies 側 (SoA)
+    // 色と半径は Entity 側
+    int bodySlot;
+
+    static sf::Color withAlpha(sf::Color c, sf::Uint8 a) {
+        c.a = a;
+        return c;
+    }
+
+public:
+    // 生成前に確保しておく資源
+    //   出生バッチは確保だけを出生の順に直列で済ませ、個体の生成は並列に行う
+    struct Reservation {
+        int   qSlot;
+        int   bodySlot;
+        float direction;    // 初期の向き (度)
+        bool  freshTable;   // Qテーブルを新しく確保したか (共有先が既にあれば継承しない)
+    };
+
+    // 乱数を引き、ワールドの資源を取るので直列に呼ぶ
+    static Reservation reserve(World& world, const Genes& g, int lineageId) {
+        Reservation r;
+        r.qSlot      = world.qTables.acquire(shareKey(world.qTables.shareMode(), g, lineageId));
+        r.freshTable = world.qTables.refCount(r.qSlot) == 1;
+        r.bodySlot   = world.bodies.claim();
+        r.direction  = getRandomFloat(0.f, 360.f);
+        return r;
+    }
+
+    // コンストラクタ
+    BasicCreature(const Genes& g, sf::Vector2f pos, sf::Color color,
+             int gen, World* world, int lineageId)
+        : BasicCreature(g, pos, color, gen, world, lineageId, reserve(*world, g, lineageId))
+    {
+    }
+
+    // 確保済みの資源で作る (資源が重ならなければ別スレッドから同時に呼べる)
+    BasicCreature(const Genes& g, sf::Vector2f pos, sf::Color color,
+             int gen, World* world, int lineageId, const Reservation& r)
+        : Entity(EntityKind::Creature, 15.f, withAlpha(color, 180)),
+          pWorld(world), pQTables(&world->qTables),
+          qSlot(r.qSlot),
+          genes(g), generation(gen), lineage(lineageId),
+          bodySlot(r.bodySlot)
+    {
+        world->bodies.assign(bodySlot, this, pos, r.direction, g.speed, 60.f);
+
+        // ε-greedyのパラメータ
+        epsilon = world->params.epsilon;
+        alpha   = world->params.alpha;
+        gamma   = world->params.gamma;
+
+        currentState  = 0;
+        currentAction = 0;
+        preparedState = 0;
+        prepared      = false;
+        sensedTick    = ~0ull;   // まだ感知していない
+        sensedX       = 0.f;
+        sensedY       = 0.f;
+        sensedSignature = 0;
+    }
+
+    ~BasicCreature() override {
+        pQTables->release(qSlot);
+        pWorld->bodies.release(bodySlot);
+    }
+
+    // Qテーブルのスロットを共有しているのでコピー不可
+    BasicCreature(const BasicCreature&) = delete;
+    BasicCreature& operator=(const BasicCreature&) = delete;
+
+    // 代謝 (生存時間・エネルギー消費・クールダウン) は BodyStore::metabolize で処理済み
+    void update(float /*deltaTime*/) override {
+        if(!isAlive()) return;
+
+        // 時間経過に応じた報酬(微小な負)
+        float reward = pWorld->params.stepReward;
+
+        // 前フレームの行動結果に対する Q値更新
+        //   そこで観測した次状態をそのまま使う (行動選択は ActionBatch でまとめて行う)
+        currentState = updateQ(reward);
+    }
+
+    // ★死亡時(エネルギー切れ)の最終報酬 (代謝パスの餓死記録から呼ばれる)
+    //   早死に & 子孫ゼロだと大きなマイナス
+    //   子孫を残していれば多少緩和
+    void onStarved(const StarvedRecord& r) {
+        const SimParams& p = pWorld->params;
+        float reward = p.stepReward;
+        float finalReward = p.starvePenalty;                 // 基本ペナルティ
+        finalReward += r.offspringCount * p.offspringBonus;  // 子孫1体につき +5
+        finalReward += r.lifetime * p.lifetimeBonus;         // 長く生きるほど + (0.1 × 秒)
+
+        // 前フレーム分と合算
+        updateQ(reward + finalReward);
+    }
+
+    sf::Vector2f getPosition() const override {
+        return sf::Vector2f(pWorld->bodies.x[bodySlot], pWorld->bodies.y[bodySlot]);
+    }
+
+    bool isAlive() const override {
+        return pWorld->bodies.alive[bodySlot] != 0;
+    }
+
+    //------------------------------------------------------
+    // 行動選択バッチ用
+    //------------------------------------------------------
+    int getQSlot() const {
+        return qSlot;
+    }
+
+    int getCurrentState() const {
+        return currentState;
+    }
+
+    // 次の update() で使う状態を先に観測しておく
+    //   自分の感知キャッシュ以外は読むだけなので、別の個体と並列に呼べる
+    void prepareObservation() {
+        if(!isAlive()) return;
+        preparedState = observeState();
+        prepared      = true;
+    }
+
+    float getEpsilon() const {
+        return epsilon;
+    }
+
+    // バッチで選ばれた行動を記録 (実行は BodyStore::integrate でまとめて行う)
+    void setAction(int action) {
+        currentAction = action;
+        pWorld->bodies.action[bodySlot] = action;
+    }
+
+    // 行動ごとの運動量 (旋回角の sin/cos は tick ごとに1回だけ計算)
+    static ActionMotion actionMotion(float deltaTime) {
+        static_assert(NUM_ACTIONS <= ActionMotion::MAX_ACTIONS, "too many actions");
+        ActionMotion m;
+        for(int a=0; a<ActionMotion::MAX_ACTIONS; a++){
+            m.move[a] = 0.f;
+            m.cosT[a] = 1.f;
+            m.sinT[a] = 0.f;
+        }
+        // 0: 前進
+        m.move[0] = 1.f;
+        // 1,2: 左右旋回 (90度/秒)  4,5: 急旋回 (180度/秒)
+        float turn  = 90.f  * deltaTime * 3.14159f / 180.f;
+        float sharp = 180.f * deltaTime * 3.14159f / 180.f;
+        m.cosT[1] = std::cos(turn);  m.sinT[1] = -std::sin(turn);
+        m.cosT[2] = std::cos(turn);  m.sinT[2] =  std::sin(turn);
+        if(NUM_ACTIONS > 4) {
+            m.cosT[4] = std::cos(sharp); m.sinT[4] = -std::sin(sharp);
+            m.cosT[5] = std::cos(sharp); m.sinT[5] =  std::sin(sharp);
+        }
+        // 3: 停止
+        return m;
+    }
+
+    // ★捕食されたときの処理
+    void onEaten() override {
+        pWorld->bodies.alive[bodySlot] = 0;
+        // 捕食された時のペナルティ
+        // ただし子孫を残していれば多少緩和する
+        const SimParams& p = pWorld->params;
+        float finalReward = p.eatenPenalty;                   // 基本ペナルティ
+        finalReward += offspringCount() * p.offspringBonus;   // 子孫につき +5
+        finalReward += lifetime() * p.lifetimeBonus;          // 生存時間に応じ +0.1 × 秒
+
+        updateQ(finalReward);
+    }
+
+    // -----------------------------------------------------
+    // GA + RL用
+    // -----------------------------------------------------
+    const Genes& getGenes() const {
+        return genes;
+    }
+
+    float getAttackPower() const {
+        return genes.attack;
+    }
+
+    bool isPoisonous() const {
+        return genes.poison;
+    }
+
+    float getPoisonResistance() const {
+        return genes.poisonResistance;
+    }
+
+    void addEnergy(float amount) {
+        energy() += amount;
+    }
+
+    bool canReproduce() const {
+        return (energy() > 50.f && pWorld->bodies.coolDown[bodySlot] <= 0.f);
+    }
+
+    void resetReproductionCoolDown() {
+        pWorld->bodies.coolDown[bodySlot] = 5.f;
+    }
+
+    // 交配
+    //------------------------------------------------------
+    // 繁殖 (出生バッチから呼ばれる)
+    //   payReproduction : 親側の処理。子に渡すエネルギーを返す
+    //   spawnChild      : バッチで計算済みの遺伝子・体色と確保済みの資源から子を作る
+    //   blendQ          : 子に継承させる Qテーブルを計算する
+    //------------------------------------------------------
+    float payReproduction(BasicCreature& other) {
+        // 子に与えるエネルギー比: 既定 0.6f (親は残りの 0.4f)
+        const SimParams& p = pWorld->params;
+        float childEnergy = energy() * p.childEnergyShare;
+        energy() *= 1.f - p.childEnergyShare;
+
+        // ★子孫を増やした数をカウント
+        this->offspringCount() += 1; 
+        if (&other != this) {
+            other.offspringCount() += 1;
+        }
+        return childEnergy;
+    }
+
+    // 子が使うスロットにしか書き込まないので、子ごとに別スレッドから呼べる
+    std::shared_ptr<BasicCreature> spawnChild(const BasicCreature& other, const Genes& childGenes,
+                                              sf::Color childColor, float childEnergy,
+                                              const Reservation& r) const {
+        int newGen = std::max(this->generation, other.generation) + 1;
+
+        auto child = std::make_shared<BasicCreature>(childGenes, getPosition(), childColor, newGen,
+                                                     pWorld, lineage, r);
+        child->energy() = childEnergy;
+        return child;
+    }
+
+    // 両親の平均 + ゆらぎ (noise: TABLE_SIZE 個) を out に書く
+    //   Qテーブルへの書き込み (storeTable) は確率的丸めの乱数を引くので呼び出し側が順に行う
+    static void blendQ(const BasicCreature& p1, const BasicCreature& p2, const float* noise, float* out) {
+        float q1[QTableStore::TABLE_SIZE];
+        float q2[QTableStore::TABLE_SIZE];
+        p1.pQTables->loadTable(p1.qSlot, q1);
+        p2.pQTables->loadTable(p2.qSlot, q2);
+        unroll<QTableStore::TABLE_SIZE>([&](auto k) {
+            const int i = decltype(k)::value;
+            float val = 0.5f * (q1[i] + q2[i]);
+            val += noise[i];
+
+            if(val > 50.f) val = 50.f;
+            if(val < -50.f) val = -50.f;
+
+            out[i] = val;
+        });
+    }
+
+    // ポジティブ報酬付与
+    void givePositiveReward(float r) {
+        updateQ(r);
+    }
+
+    // 世代を返す
+    int getGeneration() const {
+        return generation;
+    }
+
+    // 始祖の番号
+    int getLineage() const {
+        return lineage;
+    }
+
+    // Qテーブルの平均値を返す (学習状況をざっくり見る指標)
+    float getAverageQ() const {
+        float Q[QTableStore::TABLE_SIZE];
+        pQTables->loadTable(qSlot, Q);
+        float sum = 0.f;
+        unroll<QTableStore::TABLE_SIZE>([&](auto i) {
+            sum += Q[decltype(i)::value];
+        });
+        return sum / (NUM_STATES * NUM_ACTIONS);
+    }
+
+    // “種族”名を返す
+    std::string getSpeciesName() const {
+        return Genes::speciesName(genes.speciesKey());
+    }
+
+    // 他のワールドへ移住する (中身を書き出し、この個体は死亡扱いにする)
+    Migrant emigrate() {
+        Migrant m = toMigrant();
+        pWorld->bodies.alive[bodySlot] = 0;
+        return m;
+    }
+
+    // 中身の書き出し (移住・チェックポイント用)
+    Migrant toMigrant() const {
+        Migrant m;
+        m.genes          = genes;
+        m.color          = color;
+        m.position       = getPosition();
+        m.generation     = generation;
+        m.lineage        = lineage;
+        m.energy         = energy();
+        m.lifetime       = lifetime();
+        m.offspringCount = offspringCount();
+        m.sourceId       = id;
+        m.sourceIsland   = -1;
+        m.q.resize(QTableStore::TABLE_SIZE);
+        pQTables->loadTable(qSlot, m.q.data());
+        return m;
+    }
+
+    // 他のワールドから来た個体の状態を復元する
+    //   共有モードで既存のテーブルに合流した場合、Qテーブルは移住先のものを使う
+    void immigrate(const Migrant& m) {
+        energy()         = m.energy;
+        lifetime()       = m.lifetime;
+        offspringCount() = m.offspringCount;
+        if(pQTables->refCount(qSlot) == 1) {
+            pQTables->storeTable(qSlot, m.q.data());
+        }
+    }
+
+private:
+    //------------------------------------------------------
+    // BodyStore 上の自分の値
+    //------------------------------------------------------
+    float& energy()             { return pWorld->bodies.energy[bodySlot]; }
+    float  energy() const       { return pWorld->bodies.energy[bodySlot]; }
+    float& lifetime()           { return pWorld->bodies.lifetime[bodySlot]; }
+    float  lifetime() const     { return pWorld->bodies.lifetime[bodySlot]; }
+    int32_t& offspringCount()   { return pWorld->bodies.offspringCount[bodySlot]; }
+    int32_t  offspringCount() const { return pWorld->bodies.offspringCount[bodySlot]; }
+
+    //------------------------------------------------------
+    // Qテーブル共有キー (個体専用なら -1)
+    //------------------------------------------------------
+    static int shareKey(QShareMode mode, const Genes& g, int lineageId) {
+        switch(mode) {
+            case QShareMode::Species: return g.speciesKey();
+            case QShareMode::Lineage: return lineageId;
+            case QShareMode::PerCreature:
+            default:                  return -1;
+        }
+    }
+
+    //------------------------------------------------------
+    // 状態観測
+    //   感知キャッシュが有効ならそれを使い、自分の移動分だけ相対位置をずらす
+    //   (周囲は止まっていると見なす)
+    //------------------------------------------------------
+    int observeState() {
+        sf::Vector2f position = getPosition();
+        const SenseCacheConfig& cache = pWorld->senseCache;
+        const bool caching = cache.maxAge > 1;
+        uint32_t signature = (caching && cache.cellCheck)
+            ? pWorld->cells.signature(position.x, position.y, genes.senseRange) : 0;
+        float mx = position.x - sensedX;
+        float my = position.y - sensedY;
+        bool reuse = caching
+            && sensedTick <= pWorld->tick
+            && pWorld->tick - sensedTick < (uint64_t)cache.maxAge
+            && mx*mx + my*my <= cache.moveLimit * cache.moveLimit
+            && signature == sensedSignature;
+        if(!reuse) {
+            sense(position);
+            sensedTick      = pWorld->tick;
+            sensedX         = position.x;
+            sensedY         = position.y;
+            sensedSignature = signature;
+        }
+
+        Observation o = sensed;
+        if(reuse && StateEncoder::NEEDS_NEAREST) {
+            sf::Vector2f moved(mx, my);
+            if(o.foodNear) {
+                o.foodDir  -= moved;
+                o.foodDist2 = o.foodDir.x * o.foodDir.x + o.foodDir.y * o.foodDir.y;
+            }
+            if(o.predatorNear) {
+                o.predatorDir  -= moved;
+                o.predatorDist2 = o.predatorDir.x * o.predatorDir.x + o.predatorDir.y * o.predatorDir.y;
+            }
+        }
+        o.energy   = energy();
+        o.headingX = pWorld->bodies.hx[bodySlot];
+        o.headingY = pWorld->bodies.hy[bodySlot];
+        return StateEncoder::encode(o);
+    }
+
+    //------------------------------------------------------
+    // 感知 (周囲をチェックして sensed を作り直す)
+    //------------------------------------------------------
+    void sense(sf::Vector2f position) {
+        Observation& o = sensed;
+        o.foodNear      = false;
+        o.predatorNear  = false;
+        o.senseRange2   = genes.senseRange * genes.senseRange;
+        o.foodDist2     = o.senseRange2;
+        o.predatorDist2 = o.senseRange2;
+
+        // 近傍候補を 64 個ずつカーネルで判定し、感知範囲内のものだけ見る
+        //   (植物は攻撃力 -1 として詰めてあるので「餌」側に入る)
+        const NeighborIndex& index = pWorld->neighborsAt(position.x);
+        const NeighborPack& pack = index.pack;
+        NeighborProbe probe = { position.x, position.y, getCollisionRadius(), o.senseRange2, genes.attack };
+        index.query(probe, genes.senseRange, [&](size_t start, const NeighborMasks& m) {
+            uint64_t bits = m.sense & (m.food | m.predator);
+            while(bits) {
+                int i = popLowestBit(bits);
+                size_t j = start + i;
+                Entity* e = pack.owner[j];
+                if(e == this || !e->isAlive()) continue;
+                float dx = pack.x[j] - position.x;
+                float dy = pack.y[j] - position.y;
+                float dist2 = dx*dx + dy*dy;
+                if((m.food >> i) & 1) {
+                    o.foodNear = true;
+                    if(StateEncoder::NEEDS_NEAREST && dist2 < o.foodDist2) {
+                        o.foodDist2 = dist2;
+                        o.foodDir   = sf::Vector2f(dx, dy);
+                    }
+                } else {
+                    o.predatorNear = true;
+                    if(StateEncoder::NEEDS_NEAREST && dist2 < o.predatorDist2) {
+                        o.predatorDist2 = dist2;
+                        o.predatorDir   = sf::Vector2f(dx, dy);
+                    }
+                }
+                if(!StateEncoder::NEEDS_NEAREST && o.foodNear && o.predatorNear) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    //------------------------------------------------------
+    // Q値更新
+    //------------------------------------------------------
+    int updateQ(float reward) {
+        int s = currentState;
+        int a = currentAction;
+
+        int sNext = prepared ? preparedState : observeState();
+        prepared = false;
+        float maxQNext = pQTables->maxValue(qSlot, sNext);
+        float oldQ = pQTables->value(qSlot, s * NUM_ACTIONS + a);
+        pQTables->addUpdate(qSlot, s * NUM_ACTIONS + a,
+                            alpha * (reward + gamma * maxQNext - oldQ));
+        return sNext;
+    }
+};
+
+//----------------------------------------------------------
+// 学習エージェントの構成 (コンパイル時に選択)
+//   例: g++ -DEVO_STATE_ENCODER=SectorEncoder -DEVO_NUM_ACTIONS=6 -DEVO_Q_STORAGE=Int8QStorage ...
+//----------------------------------------------------------
+#ifndef EVO_STATE_ENCODER
+#define EVO_STATE_ENCODER NearFlagsEncoder
+#endif
+#ifndef EVO_NUM_ACTIONS
+#define EVO_NUM_ACTIONS 4
+#endif
+#ifndef EVO_Q_STORAGE
+#define EVO_Q_STORAGE FloatQStorage
+#endif
+
+typedef BasicCreature<EVO_STATE_ENCODER, EVO_NUM_ACTIONS, EVO_Q_STORAGE> Creature;
+typedef Creature::QTableStore QTableStore;
+typedef Creature::World World;
+typedef BasicActionBatch<QTableStore> ActionBatch;
+
+class TaskScheduler;
+
+//----------------------------------------------------------
+// コマンドバッファの適用 (tick 末にワールドを書き換える唯一のステップ)
+//   1. 餓死    : 最終報酬を与えて削除登録
+//   2. 捕食    : 獲物ごとに最初の1件だけ成立 (獲物か捕食者が既に死んでいれば無効)
+//   3. 出生    : 両親がまだ繁殖可能な場合のみ成立
+//                資源 (Qテーブル・BodyStore のスロット・Entity の位置と通し番号) を出生の順に
+//                直列で確保してから、子の生成を scheduler で並列に行う
+//   4. 共有Qテーブルへの保留更新を反映し、死亡した Entity を削除
+//----------------------------------------------------------
+struct CommitScratch {
+    std::vector<StarveCommand> starves;
+    std::vector<EatCommand>    eats;
+    std::vector<BirthCommand>  births;
+
+    // 出生バッチ
+    std::vector<BirthCommand>  accepted;    // 成立した出生
+    std::vector<float>         childEnergy;
+    std::vector<float>         qNoise;      // Qテーブル継承のゆらぎ (子ごとに TABLE_SIZE 個)
+    std::vector<float>         childQ;      // 継承した Qテーブル (子ごとに TABLE_SIZE 個)
+    std::vector<Creature::Reservation> reservations;
+    GeneBatch                  geneBatch;
+    LaneRng                    birthRng;
+};
+
+// 子の生成をこの数ずつまとめて1タスクにする (少ない出生は呼び出したスレッドでそのまま作る)
+const size_t BIRTH_GRAIN = 32;
+
+// 適用の結果 (成立した件数)
+struct CommitCounts {
+    uint32_t births  = 0;
+    uint32_t starved = 0;
+    uint32_t eaten   = 0;
+};
+
+// Scheduler は TaskScheduler (下で定義する。呼び出し側で実体化されるので前方宣言で足りる)
+template <class Scheduler = TaskScheduler>
+CommitCounts commitCommands(World& world, CommitScratch& scratch, Scheduler* scheduler = nullptr) {
+    world.commands.gather(scratch.starves, scratch.eats, scratch.births);
+
+    const bool logging = world.lineage.enabled();
+    CommitCounts counts;
+    counts.starved = (uint32_t)scratch.starves.size();
+
+    for(const StarveCommand& c : scratch.starves) {
+        Creature* victim = static_cast<Creature*>(c.victim);
+        victim->onStarved(c.record);
+        world.entities.markDead(c.victim);
+        if(logging) {
+            world.lineage.recordDeath(DeathCause::Starved, world.tick, victim->id, 0,
+                                      victim->getGenes(), victim->getGeneration(), victim->getLineage());
+        }
+    }
+
+    for(const EatCommand& c : scratch.eats) {
+        if(!c.prey->isAlive()) continue;
+        if(!c.predator->isAlive()) continue;
+        c.prey->onEaten();
+        world.entities.markDead(c.prey);
+        if(c.prey->getKind() == EntityKind::Creature) counts.eaten++;
+        Creature* predator = static_cast<Creature*>(c.predator);
+        if(logging) {
+            if(Creature* victim = dynamic_cast<Creature*>(c.prey)) {
+                world.lineage.recordDeath(DeathCause::Eaten, world.tick, victim->id, predator->id,
+                                          victim->getGenes(), victim->getGeneration(), victim->getLineage());
+            }
+        }
+        predator->addEnergy(c.energy);
+        predator->givePositiveReward(c.reward);
+        if(c.poisonDamage > 0.f) {
+            predator->addEnergy(-c.poisonDamage);
+        }
+    }
+
+    // 出生: 成立判定と親側の処理を先に済ませ、子の遺伝子はまとめて計算する
+    scratch.accepted.clear();
+    scratch.childEnergy.clear();
+    scratch.geneBatch.clear();
+    for(const BirthCommand& c : scratch.births) {
+        Creature* a = static_cast<Creature*>(c.parentA);
+        Creature* b = static_cast<Creature*>(c.parentB);
+        if(!a->isAlive() || !a->canReproduce()) continue;
+        if(!b->isAlive() || !b->canReproduce()) continue;
+        scratch.accepted.push_back(c);
+        scratch.childEnergy.push_back(a->payReproduction(*b));
+        scratch.geneBatch.push(a->getGenes(), b->getGenes(), a->getColor(), b->getColor());
+        a->resetReproductionCoolDown();
+        b->resetReproductionCoolDown();
+    }
+    counts.births = (uint32_t)scratch.accepted.size();
+    if(!scratch.accepted.empty()) {
+        const size_t n = scratch.accepted.size();
+        const int tableSize = QTableStore::TABLE_SIZE;
+        scratch.geneBatch.generate(world.params, scratch.birthRng);
+        scratch.qNoise.resize(n * tableSize);
+        scratch.birthRng.fillUniform(scratch.qNoise.data(), (int)scratch.qNoise.size(), -0.1f, 0.1f);
+        world.bodies.reserve(n);
+
+        // 資源の確保 (乱数の消費順・スロット・通し番号は1体ずつ作った場合と同じ)
+        scratch.reservations.resize(n);
+        for(size_t i=0; i<n; i++) {
+            Creature* a = static_cast<Creature*>(scratch.accepted[i].parentA);
+            scratch.reservations[i] = Creature::reserve(world, scratch.geneBatch.child.get(i), a->getLineage());
+        }
+        const EntityList::Claim claim = world.entities.claim(n);
+
+        // 子の生成 (子ごとに書き込み先が別なので並列に作れる)
+        scratch.childQ.resize(n * tableSize);
+        auto spawn = [&](size_t lo, size_t hi) {
+            for(size_t i=lo; i<hi; i++) {
+                Creature* a = static_cast<Creature*>(scratch.accepted[i].parentA);
+                Creature* b = static_cast<Creature*>(scratch.accepted[i].parentB);
+                const Creature::Reservation& r = scratch.reservations[i];
+                auto child = a->spawnChild(*b, scratch.geneBatch.child.get(i),
+                                           scratch.geneBatch.childColor[i],
+                                           scratch.childEnergy[i], r);
+                if(r.freshTable) {
+                    Creature::blendQ(*a, *b, &scratch.qNoise[i * tableSize], &scratch.childQ[i * tableSize]);
+                }
+                world.entities.place(claim, i, std::move(child));
+            }
+        };
+        if(scheduler) {
+            scheduler->parallelFor(0, n, BIRTH_GRAIN, spawn);
+        } else {
+            spawn(0, n);
+        }
+
+        // Qテーブルの書き込みと系統ログは出生の順に
+        for(size_t i=0; i<n; i++) {
+            const Creature::Reservation& r = scratch.reservations[i];
+            if(r.freshTable) world.qTables.storeTable(r.qSlot, &scratch.childQ[i * tableSize]);
+            if(logging) {
+                const Creature* a = static_cast<const Creature*>(scratch.accepted[i].parentA);
+                const Creature* b = static_cast<const Creature*>(scratch.accepted[i].parentB);
+                const Creature* child = static_cast<const Creature*>(world.entities[claim.first + i].get());
+                world.lineage.recordBirth(LineageKind::Birth, world.tick, child->id, a->id, b->id,
+                                          child->getGenes(), child->getGeneration(), child->getLineage());
+            }
+        }
+    }
+
+    world.qTables.applyPending();
+    world.entities.removeDead();
+    return counts;
+}
+
+//----------------------------------------------------------
+// 集計値 (UI 表示・ログ出力用)
+//----------------------------------------------------------
+struct SimStats {
+    int   creatureCount = 0;
+    int   plantCount    = 0;
+    int   maxGeneration = 0;
+    float averageQ      = 0.f;
+    std::map<std::string, int> speciesCount;
+};
+
+//----------------------------------------------------------
+// 描画用スナップショット (シミュレーションスレッド → 描画スレッド)
+//   描画に必要な最小限の値だけをコピーする
+//----------------------------------------------------------
+struct RenderItem {
+    float      x, y;
+    float      radius;
+    sf::Color  color;
+    EntityKind kind;
+};
+
+struct RenderSnapshot {
+    std::vector<RenderItem> items;
+    SimStats stats;
+    uint64_t tick = 0;
+};
+
+//----------------------------------------------------------
+// トリプルバッファ (書き込み側 1 スレッド・読み込み側 1 スレッド)
+//   書き込み側は back を埋めて publish() で middle と交換し、
+//   読み込み側は acquire() で新しい middle があれば front と交換する
+//   どちらも相手を待たず、読み込み側は常に最後に完成したデータを見る
+//----------------------------------------------------------
+template <class T>
+class TripleBuffer {
+public:
+    // 書き込み側: 次に埋めるバッファ
+    T& writeBuffer() {
+        return buffers[back];
+    }
+
+    // 書き込み側: 埋め終えたバッファを公開
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // 読み込み側: 新しいバッファがあれば取得 (無ければ前回のまま false)
+    bool acquire() {
+        if(!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // 読み込み側: 最後に取得したバッファ
+    const T& readBuffer() const {
+        return buffers[front];
+    }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH      = 4;   // middle が未読であることを示すビット
+
+    T buffers[3];
+    int front = 0;                 // 読み込み側専用
+    int back  = 1;                 // 書き込み側専用
+    std::atomic<int> middle{2};
+};
+
+//----------------------------------------------------------
+// プロセスに許可されている CPU の一覧 (taskset / cgroup の制限を反映する)
+//   取得できない環境では空を返す
+//----------------------------------------------------------
+inline std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#if defined(EVO_HAS_THREAD_AFFINITY)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int c=0; c<CPU_SETSIZE; c++) {
+            if(CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+    }
+#endif
+    return cpus;
+}
+
+//----------------------------------------------------------
+// 呼び出したスレッドを CPU に固定する (対応していない環境では何もしない)
+//----------------------------------------------------------
+inline bool pinCurrentThread(int cpu) {
+#if defined(EVO_HAS_THREAD_AFFINITY)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+//----------------------------------------------------------
+// タスクの依存グラフ
+//   add() でタスクを足し、precede(a, b) で「a が終わってから b」を指定する
+//----------------------------------------------------------
+class TaskGraph {
+public:
+    int add(std::function<void()> fn) {
+        nodes.emplace_back(new Node);
+        nodes.back()->fn = std::move(fn);
+        return (int)nodes.size() - 1;
+    }
+
+    void precede(int before, int after) {
+        nodes[before]->successors.push_back(after);
+        nodes[after]->deps++;
+    }
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+private:
+    friend class TaskScheduler;
+
+    struct Node {
+        std::function<void()> fn;
+        std::vector<int>      successors;
+        int                   deps = 0;
+        std::atomic<int>      remaining{0};   // 実行中に使う未完了の依存数
+    };
+    std::vector<std::unique_ptr<Node>> nodes;
+};
+
+//----------------------------------------------------------
+// ワークスティーリング方式のタスクスケジューラ
+//   ワーカーごとに両端キューを持ち、自分のキューは後ろから (LIFO) 取り、
+//   空になったら他のワーカーのキューの前から (FIFO) 盗む
+//   混んだセルの近くだけ重いような偏った負荷でも、空いたワーカーが残りを引き取る
+//   完了を待つスレッド (ワーカー以外も) は待つ間、自分が待っている組のタスクだけを実行し、
+//   無ければ眠るので、タスクの中から parallelFor / run を入れ子に呼べる
+//   (島の tick の中の帯ごとの処理など)。待っている間に無関係な重いタスク
+//   (別の島の epoch やスイープの1試行) を抱え込むことはない
+//   threads はスレッドの総数で、呼び出し側も1本と数える (ワーカーは threads - 1 本)
+//   pin を指定するとワーカーだけを許可された CPU に1本ずつ固定し、呼び出し側は固定しない
+//   (後から作るスレッドが呼び出し側の CPU 指定を引き継がないように)
+//----------------------------------------------------------
+class TaskScheduler {
+public:
+    explicit TaskScheduler(int threads, bool pin = false)
+        : counters(new Counters[std::max(1, threads)]), started(std::chrono::steady_clock::now())
+    {
+        const int n = std::max(1, threads) - 1;
+        std::vector<int> cpus;
+        if(pin) {
+            cpus = allowedCpus();
+            if(cpus.empty()) std::cerr << "Thread pinning is not available; workers are not pinned\n";
+        }
+        for(int k=0; k<n; k++) {
+            queues.emplace_back(new WorkerQueue);
+        }
+        for(int k=0; k<n; k++) {
+            // 許可された CPU の先頭は呼び出し側のために空けておく
+            const int cpu = cpus.empty() ? -1 : cpus[(k + 1) % cpus.size()];
+            workers.emplace_back([this, k, cpu]{
+                if(cpu >= 0 && !pinCurrentThread(cpu)) {
+                    std::cerr << "Failed to pin worker " << k << " to CPU " << cpu << "\n";
+                }
+                workerLoop(k);
+            });
+        }
+    }
+
+    ~TaskScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            quit = true;
+        }
+        sleepCv.notify_all();
+        for(std::thread& t : workers) t.join();
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    int threadCount() const {
+        return (int)workers.size() + 1;
+    }
+
+    // [begin, end) を grain 個ずつに分けて body(lo, hi) を並列実行し、全部終わるまで待つ
+    void parallelFor(size_t begin, size_t end, size_t grain,
+                     const std::function<void(size_t, size_t)>& body) {
+        if(end <= begin) return;
+        grain = std::max<size_t>(1, grain);
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        if(chunks == 1 || workers.empty()) {
+            body(begin, end);
+            return;
+        }
+        std::vector<Task> tasks(chunks);
+        std::atomic<int> pending((int)chunks);
+        for(size_t c=0; c<chunks; c++) {
+            tasks[c].body = &body;
+            tasks[c].lo   = begin + c * grain;
+            tasks[c].hi   = std::min(end, tasks[c].lo + grain);
+            tasks[c].done = &pending;
+        }
+        // 後ろから積むので、自分は前の方から取り、盗む側は後ろの方から取る
+        for(size_t c=chunks; c-- > 0; ) push(&tasks[c]);
+        wait(pending);
+    }
+
+    // 依存グラフを実行し、全部終わるまで待つ (依存が済んだタスクから順に積む)
+    void run(TaskGraph& graph) {
+        const size_t n = graph.size();
+        if(n == 0) return;
+        std::vector<Task> tasks(n);
+        std::atomic<int> pending((int)n);
+        std::function<void(size_t, size_t)> runNode = [&](size_t i, size_t) {
+            TaskGraph::Node& node = *graph.nodes[i];
+            node.fn();
+            for(int s : node.successors) {
+                if(graph.nodes[s]->remaining.fetch_sub(1) == 1) push(&tasks[s]);
+            }
+        };
+        for(size_t i=0; i<n; i++) {
+            graph.nodes[i]->remaining.store(graph.nodes[i]->deps);
+            tasks[i].body = &runNode;
+            tasks[i].lo   = i;
+            tasks[i].hi   = i + 1;
+            tasks[i].done = &pending;
+        }
+        for(size_t i=0; i<n; i++) {
+            if(graph.nodes[i]->deps == 0) push(&tasks[i]);
+        }
+        wait(pending);
+    }
+
+    // ワーカーごとの稼働状況 (最後の1つはワーカー以外の呼び出し側スレッド)
+    struct Utilization {
+        double   busy;    // タスクを実行していた時間の割合
+        uint64_t tasks;
+        uint64_t steals;
+    };
+
+    std::vector<Utilization> utilization() const {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::vector<Utilization> out;
+        for(int k=0; k<threadCount(); k++) {
+            const Counters& c = counters[k];
+            out.push_back(Utilization{ elapsed > 0.0 ? (double)c.busyNanos.load() * 1e-9 / elapsed : 0.0,
+                                       c.tasks.load(), c.steals.load() });
+        }
+        return out;
+    }
+
+    void report(std::ostream& os) const {
+        std::vector<Utilization> u = utilization();
+        for(size_t k=0; k<u.size(); k++) {
+            os << (k + 1 < u.size() ? "worker " + std::to_string(k) : std::string("caller  "))
+               << ": busy " << (int)(u[k].busy * 100.0 + 0.5) << "%, tasks " << u[k].tasks
+               << ", steals " << u[k].steals << "\n";
+        }
+    }
+
+private:
+    struct Task {
+        const std::function<void(size_t, size_t)>* body = nullptr;
+        size_t lo = 0, hi = 0;
+        std::atomic<int>* done = nullptr;
+    };
+
+    struct WorkerQueue {
+        std::mutex        mutex;
+        std::deque<Task*> tasks;
+    };
+
+    struct Counters {
+        std::atomic<uint64_t> busyNanos{0};
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+    };
+
+    // このスレッドがどのスケジューラのどのワーカーか (ワーカー以外は -1)
+    static TaskScheduler*& currentScheduler() {
+        static thread_local TaskScheduler* s = nullptr;
+        return s;
+    }
+    static int& currentWorker() {
+        static thread_local int k = -1;
+        return k;
+    }
+    static int& nestingDepth() {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    int ownWorker() const {
+        return currentScheduler() == this ? currentWorker() : -1;
+    }
+
+    // ワーカーからは自分のキュー、それ以外からは共有キューに積む
+    void push(Task* t) {
+        int k = ownWorker();
+        WorkerQueue& q = k >= 0 ? *queues[k] : injected;
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(t);
+        }
+        queued.fetch_add(1);
+        if(sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCv.notify_one();
+        }
+        signalWaiters();
+    }
+
+    // 完了を待っているスレッドを起こす (新しいタスクが積まれたか、ある組が終わった)
+    void signalWaiters() {
+        waitEvents.fetch_add(1);
+        if(waiting.load() > 0) {
+            { std::lock_guard<std::mutex> lock(waitMutex); }
+            waitCv.notify_all();
+        }
+    }
+
+    // q から組 group のタスクを1つ取り出す (fromBack なら後ろから探す)
+    Task* takeGroupTask(WorkerQueue& q, const std::atomic<int>* group, bool fromBack) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        const size_t n = q.tasks.size();
+        for(size_t j=0; j<n; j++) {
+            const size_t i = fromBack ? n - 1 - j : j;
+            if(q.tasks[i]->done != group) continue;
+            Task* t = q.tasks[i];
+            q.tasks.erase(q.tasks.begin() + (std::ptrdiff_t)i);
+            queued.fetch_sub(1);
+            return t;
+        }
+        return nullptr;
+    }
+
+    // 自分のキュー → 共有キュー → 他のワーカーのキュー の順に、組 group のタスクだけを探す
+    Task* findGroupTask(int k, int slot, const std::atomic<int>* group) {
+        if(k >= 0) {
+            if(Task* t = takeGroupTask(*queues[k], group, true)) return t;
+        }
+        if(Task* t = takeGroupTask(injected, group, false)) return t;
+        const int n = (int)queues.size();
+        for(int i=1; i<=n; i++) {
+            int victim = (k + i + n) % n;
+            if(victim == k) continue;
+            if(Task* t = takeGroupTask(*queues[victim], group, false)) {
+                counters[slot].steals.fetch_add(1);
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    Task* popBack(WorkerQueue& q) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(q.tasks.empty()) return nullptr;
+        Task* t = q.tasks.back();
+        q.tasks.pop_back();
+        queued.fetch_sub(1);
+        return t;
+    }
+
+    Task* popFront(WorkerQueue& q) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if(q.tasks.empty()) return nullptr;
+        Task* t = q.tasks.front();
+        q.tasks.pop_front();
+        queued.fetch_sub(1);
+        return t;
+    }
+
+    // 自分のキュー → 共有キュー → 他のワーカーのキュー の順に探す
+    Task* findTask(int k, int slot) {
+        if(k >= 0) {
+            if(Task* t = popBack(*queues[k])) return t;
+        }
+        if(Task* t = popFront(injected)) return t;
+        const int n = (int)queues.size();
+        for(int i=1; i<=n; i++) {
+            int victim = (k + i + n) % n;
+            if(victim == k) continue;
+            if(Task* t = popFront(*queues[victim])) {
+                counters[slot].steals.fetch_add(1);
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    void execute(Task* t, int slot) {
+        // 入れ子 (待っている間に実行したタスク) は外側の時間に含まれるので数えない
+        const bool outermost = nestingDepth()++ == 0;
+        auto t0 = std::chrono::steady_clock::now();
+        (*t->body)(t->lo, t->hi);
+        if(outermost) {
+            counters[slot].busyNanos.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count());
+        }
+        nestingDepth()--;
+        counters[slot].tasks.fetch_add(1);
+        // 最後の1つなら待っているスレッドを起こす (t は待ち側のスタック上にあるので先に読む)
+        std::atomic<int>* done = t->done;
+        if(done->fetch_sub(1, std::memory_order_acq_rel) == 1) signalWaiters();
+    }
+
+    // pending が 0 になるまで、同じ組のタスクを実行しながら待つ
+    //   組のタスクが他のスレッドで実行中なら、終わるか新しいタスクが積まれるまで眠る
+    void wait(std::atomic<int>& pending) {
+        const int k = ownWorker();
+        const int slot = k >= 0 ? k : (int)workers.size();
+        while(pending.load(std::memory_order_acquire) > 0) {
+            const uint64_t seen = waitEvents.load();
+            if(Task* t = findGroupTask(k, slot, &pending)) {
+                execute(t, slot);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(waitMutex);
+            waiting.fetch_add(1);
+            waitCv.wait(lock, [&]{
+                return pending.load(std::memory_order_acquire) == 0 || waitEvents.load() != seen;
+            });
+            waiting.fetch_sub(1);
+        }
+    }
+
+    void workerLoop(int k) {
+        currentScheduler() = this;
+        currentWorker()    = k;
+        for(;;) {
+            if(Task* t = findTask(k, k)) {
+                execute(t, k);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            sleepCv.wait(lock, [&]{ return quit || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if(quit) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    WorkerQueue injected;                      // ワーカー以外から積まれたタスク
+    std::vector<std::thread> workers;
+    std::unique_ptr<Counters[]> counters;
+    std::chrono::steady_clock::time_point started;
+
+    std::atomic<int> queued{0};                // キューに入っているタスクの総数
+    std::atomic<int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCv;
+    bool quit = false;
+
+    std::atomic<uint64_t> waitEvents{0};       // 積まれたタスクと終わった組の通し番号
+    std::atomic<int> waiting{0};               // wait() で眠っているスレッドの数
+    std::mutex waitMutex;
+    std::condition_variable waitCv;
+};
+
+//----------------------------------------------------------
+// 監視用の計測値 (--metrics)
+//   書き込むのはシミュレーションスレッドだけで、tick ごとの件数と
+//   フェーズごとの所要時間は原子変数へ、集計値 (SimStats) は一定 tick ごとに
+//   トリプルバッファへ公開する。読み出し側 (MetricsServer) はどちらも待たずに読める
+//----------------------------------------------------------
+enum class SimPhase : int {
+    Metabolize,   // 代謝
+    Observe,      // 観測と Q値更新
+    Act,          // 行動選択と移動
+    Collide,      // 衝突・捕食判定
+    Reproduce,    // 交配相手の選択
+    Commit,       // コマンドの適用と植物の補充
+    Count
+};
+
+inline const char* simPhaseName(SimPhase p) {
+    static const char* names[] = { "metabolize", "observe", "act", "collide", "reproduce", "commit" };
+    return names[(int)p];
+}
+
+struct MetricsSnapshot {
+    SimStats stats;
+    uint64_t tick = 0;
+    double   ticksPerSecond = 0.0;   // 直前の公開からの平均
+};
+
+class SimMetrics {
+public:
+    static const int PHASES = (int)SimPhase::Count;
+    static const int CAUSES = 4;      // DeathCause の種類数
+    static const uint64_t STATS_EVERY = 60;   // 集計値を公開する間隔 (tick)
+
+    SimMetrics() {
+        for(auto& d : deaths) d.store(0, std::memory_order_relaxed);
+        for(auto& t : phaseNanos) t.store(0, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------
+    // 書き込み側 (シミュレーションスレッド)
+    //------------------------------------------------------
+    void addPhaseTime(SimPhase p, std::chrono::steady_clock::duration d) {
+        phaseNanos[(int)p].fetch_add(
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+            std::memory_order_relaxed);
+    }
+
+    void countTick(const CommitCounts& c) {
+        births.fetch_add(c.births, std::memory_order_relaxed);
+        deaths[(int)DeathCause::Starved].fetch_add(c.starved, std::memory_order_relaxed);
+        deaths[(int)DeathCause::Eaten].fetch_add(c.eaten, std::memory_order_relaxed);
+        ticks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void countDeaths(DeathCause cause, uint32_t n) {
+        deaths[(int)cause].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    bool statsDue(uint64_t tick) const {
+        return tick % STATS_EVERY == 0;
+    }
+
+    void publishStats(const SimStats& stats, uint64_t tick) {
+        auto now = std::chrono::steady_clock::now();
+        MetricsSnapshot& snap = snapshots.writeBuffer();
+        snap.stats = stats;
+        snap.tick  = tick;
+        double elapsed = std::chrono::duration<double>(now - lastPublish).count();
+        snap.ticksPerSecond = (publishedTick > 0 && elapsed > 0.0) ? (tick - publishedTick) / elapsed : 0.0;
+        snapshots.publish();
+        lastPublish   = now;
+        publishedTick = tick;
+    }
+
+    //------------------------------------------------------
+    // 読み出し側 (1 スレッドのみ)
+    //------------------------------------------------------
+    uint64_t tickCount() const {
+        return ticks.load(std::memory_order_relaxed);
+    }
+
+    uint64_t birthCount() const {
+        return births.load(std::memory_order_relaxed);
+    }
+
+    uint64_t deathCount(DeathCause cause) const {
+        return deaths[(int)cause].load(std::memory_order_relaxed);
+    }
+
+    double phaseSeconds(SimPhase p) const {
+        return phaseNanos[(int)p].load(std::memory_order_relaxed) * 1e-9;
+    }
+
+    // 最後に公開された集計値 (まだ無ければ既定値)
+    const MetricsSnapshot& latest() {
+        snapshots.acquire();
+        return snapshots.readBuffer();
+    }
+
+private:
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> births{0};
+    std::atomic<uint64_t> deaths[CAUSES];
+    std::atomic<uint64_t> phaseNanos[PHASES];
+    TripleBuffer<MetricsSnapshot> snapshots;
+
+    // 書き込み側専用
+    std::chrono::steady_clock::time_point lastPublish;
+    uint64_t publishedTick = 0;
+};
+
+// フェーズの区切りごとに lap() を呼ぶと、前の区切りからの時間をそのフェーズに足す
+//   (計測しない時は時計も読まない)
+class PhaseTimer {
+public:
+    explicit PhaseTimer(SimMetrics* m) : metrics(m) {
+        if(metrics) last = std::chrono::steady_clock::now();
+    }
+
+    void lap(SimPhase p) {
+        if(!metrics) return;
+        auto now = std::chrono::steady_clock::now();
+        metrics->addPhaseTime(p, now - last);
+        last = now;
+    }
+
+private:
+    SimMetrics* metrics;
+    std::chrono::steady_clock::time_point last;
+};
+
+//----------------------------------------------------------
+// ローカル専用の待ち受けソケット
+//   "PORT"      : 127.0.0.1:PORT (TCP)
+//   "unix:PATH" : Unix ドメインソケット (同じパスに残ったソケットは置き換える)
+//   失敗したら理由を標準エラーに出して -1 を返す
+//----------------------------------------------------------
+int openLocalListener(const std::string& spec) {
+    int fd = -1;
+    int err = 0;
+    // 失敗したら閉じる (errno は close の前に残す)
+    auto fail = [&]() {
+        err = errno;
+        close(fd);
+        fd = -1;
+    };
+    if(spec.rfind("unix:", 0) == 0) {
+        std::string path = spec.substr(5);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        if(path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Bad socket path: " << path << "\n";
+            return -1;
+        }
+        struct stat st;
+        if(stat(path.c_str(), &st) == 0) {
+            if(!S_ISSOCK(st.st_mode)) {
+                std::cerr << "Not a socket (refusing to replace): " << path << "\n";
+                return -1;
+            }
+            unlink(path.c_str());
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0) err = errno;
+        if(fd >= 0 && bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) fail();
+    } else {
+        char* end = nullptr;
+        long port = std::strtol(spec.c_str(), &end, 10);
+        if(spec.empty() || *end != '\0' || port <= 0 || port > 65535) {
+            std::cerr << "Bad listen address (use PORT or unix:PATH): " << spec << "\n";
+            return -1;
+        }
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0) err = errno;
+        int one = 1;
+        if(fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if(fd >= 0 && bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) fail();
+    }
+    if(fd >= 0 && listen(fd, 8) != 0) fail();
+    if(fd < 0) {
+        std::cerr << "Failed to listen on " << spec << ": " << std::strerror(err) << "\n";
+    }
+    return fd;
+}
+
+// 全部書くか、相手が切るまで送る (相手が切っても SIGPIPE で落ちないように)
+inline bool sendAll(int fd, const std::string& data) {
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, flags);
+        if(n <= 0) return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+//----------------------------------------------------------
+// 計測値の HTTP 公開 (--metrics=PORT / --metrics=unix:PATH)
+//   専用スレッドで GET /metrics に Prometheus のテキスト形式で答える
+//   接続は1つずつ順に処理し、1 接続には REQUEST_DEADLINE_MS までしか付き合わない
+//   (ゆっくり送ってくるクライアントがいても、他の取得が待たされるのはその間だけ)
+//   計測値は SimMetrics から待たずに読むので、シミュレーションはクライアントに止められない
+//----------------------------------------------------------
+class MetricsServer {
+public:
+    explicit MetricsServer(const std::string& spec) : spec(spec) {}
+
+    ~MetricsServer() {
+        stop();
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // 計測するワールドを追加して書き込み先を返す (start() より前に呼ぶ。name はラベル world の値)
+    //   書き込み先はサーバーが持つので、ワールドが先に破棄されても読める
+    SimMetrics* track(const std::string& name) {
+        sources.emplace_back(name, std::unique_ptr<SimMetrics>(new SimMetrics()));
+        return sources.back().second.get();
+    }
+
+    bool start() {
+        listenFd = openLocalListener(spec);
+        if(listenFd < 0) return false;
+        worker = std::thread([this]{ run(); });
+        if(spec.rfind("unix:", 0) == 0) {
+            std::cerr << "Metrics: " << spec.substr(5) << " (GET /metrics)\n";
+        } else {
+            std::cerr << "Metrics: http://127.0.0.1:" << spec << "/metrics\n";
+        }
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if(worker.joinable()) worker.join();
+        if(listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+            if(spec.rfind("unix:", 0) == 0) unlink(spec.substr(5).c_str());
+        }
+    }
+
+    // Prometheus のテキスト形式 (サーバースレッドから呼ぶ)
+    void render(std::ostream& out) {
+        std::vector<const MetricsSnapshot*> snaps;
+        for(auto& s : sources) snaps.push_back(&s.second->latest());
+
+        auto family = [&](const char* name, const char* type, const char* help) {
+            out << "# HELP " << name << " " << help << "\n"
+                << "# TYPE " << name << " " << type << "\n";
+        };
+        auto sample = [&](const char* name, size_t k, const std::string& extra, double value) {
+            out << name << "{world=\"" << escapeLabel(sources[k].first) << "\"" << extra << "} " << value << "\n";
+        };
+
+        out.precision(10);
+        family("evo_ticks_total", "counter", "Simulated ticks.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_ticks_total", k, "", (double)sources[k].second->tickCount());
+
+        family("evo_ticks_per_second", "gauge", "Ticks per wall-clock second over the last stats interval.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_ticks_per_second", k, "", snaps[k]->ticksPerSecond);
+
+        family("evo_phase_seconds_total", "counter", "Wall-clock seconds spent in each tick phase.");
+        for(size_t k=0; k<sources.size(); k++) {
+            for(int p=0; p<SimMetrics::PHASES; p++) {
+                sample("evo_phase_seconds_total", k, std::string(",phase=\"") + simPhaseName((SimPhase)p) + "\"",
+                       sources[k].second->phaseSeconds((SimPhase)p));
+            }
+        }
+
+        family("evo_births_total", "counter", "Creatures born.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_births_total", k, "", (double)sources[k].second->birthCount());
+
+        family("evo_deaths_total", "counter", "Creatures that died or left the world, by cause.");
+        static const std::pair<DeathCause, const char*> causes[] = {
+            { DeathCause::Starved, "starved" }, { DeathCause::Eaten, "eaten" }, { DeathCause::Emigrated, "emigrated" }
+        };
+        for(size_t k=0; k<sources.size(); k++) {
+            for(const auto& c : causes) {
+                sample("evo_deaths_total", k, std::string(",cause=\"") + c.second + "\"",
+                       (double)sources[k].second->deathCount(c.first));
+            }
+        }
+
+        // 以下は一定 tick ごとに公開された集計値 (evo_stats_tick の時点)
+        family("evo_stats_tick", "gauge", "Tick at which the population gauges were computed.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_stats_tick", k, "", (double)snaps[k]->tick);
+
+        family("evo_creatures", "gauge", "Living creatures.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_creatures", k, "", snaps[k]->stats.creatureCount);
+
+        family("evo_plants", "gauge", "Living plants.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_plants", k, "", snaps[k]->stats.plantCount);
+
+        family("evo_species_creatures", "gauge", "Living creatures per species.");
+        for(size_t k=0; k<sources.size(); k++) {
+            for(const auto& kv : snaps[k]->stats.speciesCount) {
+                sample("evo_species_creatures", k, ",species=\"" + escapeLabel(kv.first) + "\"", kv.second);
+            }
+        }
+
+        family("evo_max_generation", "gauge", "Highest generation among living creatures.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_max_generation", k, "", snaps[k]->stats.maxGeneration);
+
+        family("evo_average_q", "gauge", "Mean Q value over living creatures.");
+        for(size_t k=0; k<sources.size(); k++) sample("evo_average_q", k, "", snaps[k]->stats.averageQ);
+    }
+
+private:
+    std::string spec;
+    std::vector<std::pair<std::string, std::unique_ptr<SimMetrics>>> sources;
+    int listenFd = -1;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+
+    static std::string escapeLabel(const std::string& s) {
+        std::string out;
+        for(char c : s) {
+            if(c == '\\' || c == '"') out += '\\';
+            if(c == '\n') { out += "\\n"; continue; }
+            out += c;
+        }
+        return out;
+    }
+
+    void run() {
+        while(!stopping.load()) {
+            pollfd p = { listenFd, POLLIN, 0 };
+            if(poll(&p, 1, 200) <= 0) continue;
+            int client = accept(listenFd, nullptr, nullptr);
+            if(client < 0) continue;
+            serve(client);
+            close(client);
+        }
+    }
+
+    // リクエストの受信に掛けてよい時間 (接続ごとの合計)
+    static const int REQUEST_DEADLINE_MS = 1000;
+
+    // 1 リクエストに答える (期限までにヘッダーを読みきれなければ、そこまでの内容で答える)
+    void serve(int client) {
+        timeval timeout = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(REQUEST_DEADLINE_MS);
+        std::string request;
+        char buf[1024];
+        while(request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            const long long left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if(left <= 0) break;
+            pollfd p = { client, POLLIN, 0 };
+            if(poll(&p, 1, (int)left) <= 0) break;
+            ssize_t n = recv(client, buf, sizeof(buf), 0);
+            if(n <= 0) break;
+            request.append(buf, (size_t)n);
+        }
+        std::string line = request.substr(0, request.find("\r\n"));
+
+        std::string status = "404 Not Found";
+        std::string body   = "not found\n";
+        if(line.rfind("GET /metrics ", 0) == 0 || line.rfind("GET /metrics?", 0) == 0 || line == "GET /metrics") {
+            std::ostringstream ss;
+            render(ss);
+            status = "200 OK";
+            body   = ss.str();
+        }
+        sendAll(client, "HTTP/1.0 " + status + "\r\n"
+                        "Content-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body);
+    }
+};
+const int MetricsServer::REQUEST_DEADLINE_MS;
+
+//----------------------------------------------------------
+// 単一生産者・単一消費者のリングバッファ (ロックなし)
+//   push は生産者スレッドだけ、pop は消費者スレッドだけが呼ぶ
+//----------------------------------------------------------
+template <class T, size_t N>
+class SpscRing {
+public:
+    bool push(const T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail.load(std::memory_order_acquire) == N) return false;   // 満杯
+        slots[h % N] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire)) return false;
+        v = slots[t % N];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots[N];
+    std::atomic<size_t> head{0};   // 生産者が進める
+    std::atomic<size_t> tail{0};   // 消費者が進める
+};
+
+//----------------------------------------------------------
+// 制御ソケット (--control=unix:PATH / --control=PORT)
+//   1 行 1 コマンドのテキストで、応答は結果の行のあとに "ok" か "error: 理由" の行
+//     pause              : 一時停止
+//     resume             : 再開
+//     step N             : N tick 進めて一時停止
+//     speed X            : 実時間の X 倍で進める (0 なら全速。既定)
+//     checkpoint [PATH]  : チェックポイントを書き出す (島モデルでは PATH.島番号)
+//     stats              : 現在の集計値
+//   コマンドは制御スレッドがメールボックス (SpscRing) に積み、シミュレーションを回す
+//   スレッドが tick の境目の admit() で取り出して反映し、応答を書き込む
+//   制御スレッドは待ち受けと接続中のクライアント (最大 MAX_CLIENTS) をまとめて poll するので、
+//   接続したまま何も送らないクライアントがいても他のクライアントは使える
+//----------------------------------------------------------
+struct ControlRequest {
+    enum class Kind { Pause, Resume, Step, Speed, Checkpoint, Stats };
+
+    Kind        kind = Kind::Stats;
+    long long   count = 0;      // step
+    double      speed = 0.0;    // speed
+    std::string path;           // checkpoint
+    std::string reply;          // 適用した側が書く (結果の行。空でもよい)
+    bool        failed = false;
+    std::atomic<bool> done{false};
+};
+
+class RunControl {
+public:
+    // 1 回の admit() で許す最大の tick 数 (コマンドが反映されるまでの最大の遅れ)
+    static const long long MAX_SLICE = 60;
+
+    // 同時に接続できるクライアントの数 (超えた接続にはエラーを返して切る)
+    static const size_t MAX_CLIENTS = 8;
+
+    // チェックポイント・集計値の要求を処理する関数 (シミュレーションのスレッドで呼ばれる)
+    typedef std::function<void(ControlRequest&)> Service;
+
+    explicit RunControl(const std::string& spec) : spec(spec) {}
+
+    ~RunControl() {
+        stop();
+    }
+
+    RunControl(const RunControl&) = delete;
+    RunControl& operator=(const RunControl&) = delete;
+
+    bool start() {
+        listenFd = openLocalListener(spec);
+        if(listenFd < 0) return false;
+        paceStart = std::chrono::steady_clock::now();
+        worker = std::thread([this]{ run(); });
+        std::cerr << "Control: " << (spec.rfind("unix:", 0) == 0 ? spec.substr(5) : "127.0.0.1:" + spec) << "\n";
+        return true;
+    }
+
+    // 以後 admit() を待たせない (一時停止中のシミュレーションを終了させる時に)
+    void interrupt() {
+        interrupted = true;
+    }
+
+    // admit() を呼ぶスレッドが止まってから呼ぶ
+    void stop() {
+        interrupted = true;
+        stopping = true;
+        if(worker.joinable()) worker.join();
+        if(listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+            if(spec.rfind("unix:", 0) == 0) unlink(spec.substr(5).c_str());
+        }
+    }
+
+    //------------------------------------------------------
+    // シミュレーション側: tick の境目で呼ぶ
+    //   届いたコマンドを反映し、一時停止中は再開・ステップの指示が来るまで待つ
+    //   速度指定があれば実時間に合わせて待つ (dt はシミュレーションの 1 tick の秒数)
+    //   返り値は今から進めてよい tick 数 (1 以上 maxTicks 以下)
+    //------------------------------------------------------
+    long long admit(long long maxTicks, float dt, const Service& service) {
+        for(;;) {
+            ControlRequest* r;
+            while(mailbox.pop(r)) {
+                apply(*r, service);
+                r->done.store(true, std::memory_order_release);
+            }
+            if(interrupted) return maxTicks;
+
+            long long n = std::min(maxTicks, MAX_SLICE);
+            if(paused) {
+                if(stepBudget == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    continue;
+                }
+                n = std::min(n, stepBudget);
+            }
+            if(speed > 0.0) {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - paceStart).count();
+                double allowed = elapsed * speed / dt - (double)pacedTicks;
+                if(allowed < 1.0) {
+                    double wait = std::min(0.005, (1.0 - allowed) * dt / speed);
+                    std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+                    continue;
+                }
+                n = std::min(n, (long long)allowed);
+                pacedTicks += n;
+            }
+            if(paused) stepBudget -= n;
+            return n;
+        }
+    }
+
+private:
+    std::string spec;
+    int listenFd = -1;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> interrupted{false};
+    SpscRing<ControlRequest*, 16> mailbox;
+
+    // シミュレーション側だけが触る
+    bool      paused = false;
+    long long stepBudget = 0;       // 一時停止中に進めてよい残りの tick 数
+    double    speed = 0.0;          // 0 なら全速
+    std::chrono::steady_clock::time_point paceStart;
+    long long pacedTicks = 0;       // paceStart から進めた tick 数
+
+    void restartPacing() {
+        paceStart  = std::chrono::steady_clock::now();
+        pacedTicks = 0;
+    }
+
+    void apply(ControlRequest& r, const Service& service) {
+        switch(r.kind) {
+            case ControlRequest::Kind::Pause:
+                paused = true;
+                stepBudget = 0;
+                break;
+            case ControlRequest::Kind::Resume:
+                paused = false;
+                restartPacing();
+                break;
+            case ControlRequest::Kind::Step:
+                paused = true;
+                stepBudget = r.count;
+                restartPacing();
+                break;
+            case ControlRequest::Kind::Speed:
+                speed = r.speed;
+                restartPacing();
+                break;
+            case ControlRequest::Kind::Checkpoint:
+            case ControlRequest::Kind::Stats:
+                service(r);
+                break;
+        }
+        if(r.kind == ControlRequest::Kind::Stats) {
+            std::ostringstream ss;
+            ss << "control paused=" << (paused ? 1 : 0) << " step_remaining=" << stepBudget
+               << " speed=" << speed << "\n";
+            r.reply += ss.str();
+        }
+    }
+
+    // "step 10" などを要求にする (書式エラーなら理由を返して false)
+    static bool parse(const std::string& line, ControlRequest& r, std::string& error) {
+        std::istringstream ss(line);
+        std::string cmd;
+        ss >> cmd;
+        if(cmd == "pause") {
+            r.kind = ControlRequest::Kind::Pause;
+        } else if(cmd == "resume") {
+            r.kind = ControlRequest::Kind::Resume;
+        } else if(cmd == "step") {
+            r.kind = ControlRequest::Kind::Step;
+            std::string n;
+            r.count = (ss >> n) ? std::atoll(n.c_str()) : 1;
+            if(r.count < 1) {
+                error = "step needs a positive tick count";
+                return false;
+            }
+        } else if(cmd == "speed") {
+            r.kind = ControlRequest::Kind::Speed;
+            if(!(ss >> r.speed) || r.speed < 0.0) {
+                error = "speed needs a multiplier >= 0 (0 = unlimited)";
+                return false;
+            }
+        } else if(cmd == "checkpoint") {
+            r.kind = ControlRequest::Kind::Checkpoint;
+            ss >> r.path;
+        } else if(cmd == "stats") {
+            r.kind = ControlRequest::Kind::Stats;
+        } else {
+            error = "unknown command (pause, resume, step N, speed X, checkpoint [PATH], stats)";
+            return false;
+        }
+        return true;
+    }
+
+    // 接続中のクライアント (受け取り途中の行を持つ)
+    struct Client {
+        int         fd;
+        std::string pending;
+    };
+
+    void run() {
+        std::vector<Client> clients;
+        std::vector<pollfd> fds;
+        while(!stopping.load()) {
+            fds.clear();
+            fds.push_back(pollfd{ listenFd, POLLIN, 0 });
+            for(const Client& c : clients) fds.push_back(pollfd{ c.fd, POLLIN, 0 });
+            if(poll(fds.data(), fds.size(), 200) <= 0) continue;
+
+            // 届いた分を処理し、切れた・壊れたクライアントを外す (fds[i + 1] が clients[i])
+            for(size_t i=clients.size(); i-- > 0; ) {
+                if(fds[i + 1].revents == 0) continue;
+                if(!receive(clients[i])) {
+                    close(clients[i].fd);
+                    clients.erase(clients.begin() + (std::ptrdiff_t)i);
+                }
+            }
+            if(fds[0].revents & POLLIN) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if(fd < 0) continue;
+                if(clients.size() >= MAX_CLIENTS) {
+                    sendAll(fd, "error: too many clients\n");
+                    close(fd);
+                    continue;
+                }
+                clients.push_back(Client{ fd, std::string() });
+            }
+        }
+        for(const Client& c : clients) close(c.fd);
+    }
+
+    // 読めるようになったクライアントから受け取り、揃った行を順に処理する (切るなら false)
+    bool receive(Client& c) {
+        char buf[512];
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if(n <= 0) return false;
+        c.pending.append(buf, (size_t)n);
+        for(;;) {
+            size_t eol = c.pending.find('\n');
+            if(eol == std::string::npos) return c.pending.size() <= 4096;
+            std::string line = c.pending.substr(0, eol);
+            c.pending.erase(0, eol + 1);
+            if(!line.empty() && line.back() == '\r') line.pop_back();
+            if(line.find_first_not_of(" \t") == std::string::npos) continue;
+            if(!execute(c.fd, line)) return false;
+        }
+    }
+
+    // 1 コマンドを反映して応答する (切るなら false)
+    bool execute(int client, const std::string& line) {
+        std::unique_ptr<ControlRequest> r(new ControlRequest());
+        std::string error;
+        if(!parse(line, *r, error)) {
+            return sendAll(client, "error: " + error + "\n");
+        }
+        if(!mailbox.push(r.get())) {
+            return sendAll(client, "error: busy\n");
+        }
+        // 次の tick の境目で反映されるのを待つ
+        //   (stopping の時は admit がもう呼ばれないので、メールボックスに残っていても解放してよい)
+        while(!r->done.load(std::memory_order_acquire) && !stopping.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if(!r->done.load(std::memory_order_acquire)) {
+            sendAll(client, "error: simulation finished\n");
+            return false;
+        }
+        return sendAll(client, r->reply + (r->failed ? "error: failed\n" : "ok\n"));
+    }
+};
+const size_t RunControl::MAX_CLIENTS;
+
+const long long RunControl::MAX_SLICE;
+
+//----------------------------------------------------------
+// ワールドの構成 (コマンドラインで選ぶ方式)
+//----------------------------------------------------------
+struct WorldOptions {
+    QShareMode      qShare  = QShareMode::PerCreature;
+    RemovalStrategy removal = RemovalStrategy::SwapAndPop;
+    SpatialMode     spatial = SpatialMode::BruteForce;
+    CollisionMode   collision = CollisionMode::Query;
+    SenseCacheConfig senseCache;
+    int             domains = 1;                 // x 方向の帯の数 (1 なら分割しない)
+    TaskScheduler*  scheduler = nullptr;         // 帯ごとの処理を投げる先 (無ければ Simulation が作る)
+};
+
+//----------------------------------------------------------
+// 空間の領域分割 (x 方向の帯)
+//   帯ごとに所有する個体の感知と衝突判定をタスクとしてスケジューラに投げる
+//   (帯の数はスレッド数より多くてよい。混んだ帯の処理中に空いたスレッドが残りの帯を引き取る)
+//   1. assign   : tick 始めに位置で所有を付け直す (前 tick に境界を越えた個体はここで移籍)
+//                 偏りが大きければ個体数が均等になるよう境界を引き直す
+//   2. exchange : 各帯が所有分を詰め (pack)、他の帯の所有分のうちのりしろ (感知範囲・接触距離の最大)
+//                 に入るものを写して帯ごとの近傍索引を作り (index)、帯ごとの処理を行う (work)
+//                 pack(全帯) → index(k) → work(k) の依存グラフで、index(k) が済んだ帯から work に進む
+//   のりしろが十分なので、帯の索引からの問い合わせは全体の索引と同じ候補を返す
+//   帯の索引に依存するのは候補だけにする (感知キャッシュの判定はワールド全体の CellStamps で行う)。
+//   これで感知キャッシュを使っていても結果は分割なしと一致する
+//----------------------------------------------------------
+class DomainDecomposition {
+public:
+    DomainDecomposition(int strips, TaskScheduler& sched)
+        : scheduler(sched), owned(strips), ownedPacks(strips), extents(strips)
+    {
+        bounds.resize(strips - 1);
+        for(int k=1; k<strips; k++) {
+            bounds[k - 1] = WORLD_WIDTH * (float)k / (float)strips;
+        }
+    }
+
+    int count() const {
+        return (int)owned.size();
+    }
+
+    // 帯 k が所有する Entity (assign の時点で生存していたもの)
+    const std::vector<Entity*>& ownedBy(int k) const {
+        return owned[k];
+    }
+
+    // 帯 k が所有する Entity の詰め合わせ (exchange の時点の位置)
+    const NeighborPack& ownedPack(int k) const {
+        return ownedPacks[k];
+    }
+
+    uint64_t rebalanceCount() const {
+        return rebalances;
+    }
+
+    // 所有の付け直し (必要なら境界の引き直し) とのりしろ幅の計算
+    void assign(World& world) {
+        const int n = count();
+        float maxSense = 0.f, maxRadius = 0.f;
+        xs.clear();
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            xs.push_back(e->getPosition().x);
+            maxRadius = std::max(maxRadius, e->getCollisionRadius());
+            if(e->getKind() == EntityKind::Creature) {
+                maxSense = std::max(maxSense, static_cast<Creature*>(e.get())->getGenes().senseRange);
+            }
+        }
+        halo = std::max(maxSense, 2.f * maxRadius);
+
+        // 最も混んだ帯が平均の REBALANCE_RATIO 倍を超えたら x の分位点で引き直す
+        counts.assign(n, 0);
+        for(float x : xs) counts[stripOf(x)]++;
+        int most = *std::max_element(counts.begin(), counts.end());
+        if(xs.size() >= (size_t)(4 * n) && most > REBALANCE_RATIO * (float)xs.size() / (float)n) {
+            for(int k=1; k<n; k++) {
+                auto nth = xs.begin() + (xs.size() * k) / n;
+                std::nth_element(xs.begin(), nth, xs.end());
+                bounds[k - 1] = *nth;
+            }
+            // 同じ x に個体が重なっていても境界が逆転しないように
+            for(int k=1; k<n - 1; k++) bounds[k] = std::max(bounds[k], bounds[k - 1]);
+            rebalances++;
+        }
+
+        for(auto& list : owned) list.clear();
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            owned[stripOf(e->getPosition().x)].push_back(e.get());
+        }
+        world.regions.resize(n);
+        world.regionBounds = bounds;
+    }
+
+    // 帯ごとの近傍索引を作り直し (現在の位置で。所有は assign の時のまま)、
+    // 索引ができた帯から work(k) を実行する (work が空なら索引を作るだけ)
+    void exchange(World& world, const std::function<void(int)>& work) {
+        const SpatialMode mode = world.spatialMode;
+        const int n = count();
+        TaskGraph graph;
+        std::vector<int> packs(n), indices(n);
+        for(int k=0; k<n; k++) {
+            packs[k] = graph.add([this, k]{ packOwned(k); });
+        }
+        for(int k=0; k<n; k++) {
+            indices[k] = graph.add([this, k, mode, &world]{ buildIndex(k, mode, world.regions[k]); });
+            for(int j=0; j<n; j++) graph.precede(packs[j], indices[k]);
+            if(work) graph.precede(indices[k], graph.add([k, &work]{ work(k); }));
+        }
+        scheduler.run(graph);
+    }
+
+private:
+    // 帯 k の所有分を詰める
+    void packOwned(int k) {
+        NeighborPack& pack = ownedPacks[k];
+        pack.clear();
+        Extent& ext = extents[k];
+        ext.lo = 1e30f;
+        ext.hi = -1e30f;
+        for(Entity* e : owned[k]) {
+            if(!e->isAlive()) continue;
+            sf::Vector2f pos = e->getPosition();
+            float atk = (e->getKind() == EntityKind::Creature)
+                      ? static_cast<Creature*>(e)->getAttackPower() : -1.f;
+            pack.push(e, pos.x, pos.y, e->getCollisionRadius(), atk);
+            ext.lo = std::min(ext.lo, pos.x);
+            ext.hi = std::max(ext.hi, pos.x);
+        }
+    }
+
+    // 帯 k の近傍索引を作る (のりしろの交換)
+    void buildIndex(int k, SpatialMode mode, NeighborIndex& index) {
+        // 帯の範囲 (所有する個体が境界の外へ動いていればそこまで広げる) + のりしろ
+        const int n = count();
+        float lo = std::min(k > 0 ? bounds[k - 1] : -1e30f, extents[k].lo) - halo;
+        float hi = std::max(k < n - 1 ? bounds[k] : 1e30f, extents[k].hi) + halo;
+        index.pack.clear();
+        for(int j=0; j<n; j++) {
+            if(extents[j].hi < lo || extents[j].lo > hi) continue;
+            const NeighborPack& src = ownedPacks[j];
+            for(size_t i=0; i<src.size(); i++) {
+                if(j != k && (src.x[i] < lo || src.x[i] > hi)) continue;
+                index.pack.push(src.owner[i], src.x[i], src.y[i], src.radius[i], src.attack[i]);
+            }
+        }
+        index.finish(mode);
+    }
+
+    // これを超える偏りで境界を引き直す (最も混んだ帯の個体数 / 平均)
+    static constexpr float REBALANCE_RATIO = 1.25f;
+
+    struct Extent {
+        float lo, hi;
+    };
+
+    int stripOf(float x) const {
+        return (int)(std::upper_bound(bounds.begin(), bounds.end(), x) - bounds.begin());
+    }
+
+    TaskScheduler& scheduler;
+    std::vector<float> bounds;                 // 帯の境界 (count() - 1 個)
+    std::vector<std::vector<Entity*>> owned;
+    std::vector<NeighborPack> ownedPacks;
+    std::vector<Extent> extents;               // 所有する個体の x の範囲
+    float halo = 0.f;
+    uint64_t rebalances = 0;
+
+    std::vector<float> xs;
+    std::vector<int>   counts;
+};
+
+constexpr float DomainDecomposition::REBALANCE_RATIO;
+
+//----------------------------------------------------------
+// シミュレーション (1つのワールドと、その tick 処理)
+//   乱数系列はワールドごとに持つので、複数のワールドを別スレッドで回せる
+//----------------------------------------------------------
+class Simulation {
+public:
+    Simulation(const WorldOptions& options, uint32_t seed, const SimParams& params = SimParams())
+        : random(seed), actionRng(seed ^ 0x5bd1e995u)
+    {
+        world.params = params;
+        commitScratch.birthRng = LaneRng(seed ^ 0x68e31da4u);
+        world.qTables.setShareMode(options.qShare);
+        world.entities.setStrategy(options.removal);
+        world.spatialMode = options.spatial;
+        world.senseCache  = options.senseCache;
+        collisionMode     = options.collision;
+        scheduler = options.scheduler;
+        if(options.domains > 1) {
+            if(!scheduler) {
+                ownScheduler.reset(new TaskScheduler(options.domains));
+                scheduler = ownScheduler.get();
+            }
+            domains.reset(new DomainDecomposition(options.domains, *scheduler));
+            world.commands.setWorkerCount(options.domains);
+        }
+    }
+
+    // Creature が World のアドレスを持っているので移動・コピー不可
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    World& getWorld() {
+        return world;
+    }
+
+    const World& getWorld() const {
+        return world;
+    }
+
+    uint64_t getTickCount() const {
+        return world.tick;
+    }
+
+    // 監視用の計測値の書き込み先 (nullptr なら計測しない)
+    void setMetrics(SimMetrics* m) {
+        metrics = m;
+    }
+
+    // 系統ログを開く (populate より前に呼ぶ)
+    bool openLineageLog(const std::string& path) {
+        if(world.lineage.open(path)) return true;
+        std::cerr << "Failed to open lineage log: " << path << "\n";
+        return false;
+    }
+
+    // 初期配置 (lineageBase: 始祖番号の開始値。ワールド間で重ならないようにする)
+    void populate(int lineageBase) {
+        RandomScope scope(random);
+
+        // 初期Creature
+        for(int i=0; i<8; i++){
+            Genes g;
+            g.speed           = getRandomFloat(30.f, 70.f);
+            g.attack          = getRandomFloat(0.f, 5.f);
+            g.poison          = (randomInt()%100 < 30);
+            g.legs            = randomInt()%4 + 1;
+            g.senseRange      = getRandomFloat(50.f, 150.f);
+            g.poisonResistance= getRandomFloat(0.f, 1.f); 
+
+            float x = getRandomFloat(100.f, 700.f);
+            float y = getRandomFloat(100.f, 500.f);
+
+            sf::Color color(
+                100 + randomInt()%156,
+                100 + randomInt()%156,
+                100 + randomInt()%156,
+                180
+            );
+            auto c = std::make_shared<Creature>(g, sf::Vector2f(x,y), color, 0, &world, lineageBase + i);
+            world.entities.push_back(c);
+            if(world.lineage.enabled()) {
+                world.lineage.recordBirth(LineageKind::Founder, world.tick, c->id, 0, 0,
+                                          g, 0, lineageBase + i);
+            }
+        }
+
+        // 初期Plant (30個)
+        for(int i = 0; i < 30; i++){
+            float x = getRandomFloat(50.f, 750.f);
+            float y = getRandomFloat(50.f, 550.f);
+            auto plant = std::make_shared<Plant>(sf::Vector2f(x,y));
+            world.entities.push_back(plant);
+        }
+    }
+
+    // 1 tick 進める
+    void step(float dt) {
+        RandomScope scope(random);
+        world.lineage.reserveAhead();
+        PhaseTimer timer(metrics);
+
+        // 領域分割: 前 tick の移動を反映して帯の所有を付け直す
+        if(domains) domains->assign(world);
+
+        // 各フェーズの死亡・捕食・出生はコマンドバッファに記録し、tick 末にまとめて適用する
+        CommandSegment& cmd = world.commands.segment(0);
+
+        // 代謝 (エネルギー消費・生存時間・クールダウン) を一括処理し、餓死を記録
+        const SimParams& p = world.params;
+        world.bodies.metabolize(dt, p.drainRate, starved);
+        for(const StarvedRecord& r : starved) {
+            cmd.starves.push_back(StarveCommand{ world.bodies.owner[r.slot], r });
+        }
+        timer.lap(SimPhase::Metabolize);
+
+        // Update (Q値更新・状態観測)
+        //   領域分割時は観測 (重い部分) だけ帯ごとに並列で先に済ませ、
+        //   Q値の更新は従来どおり Entity の順に行う (共有テーブルへの反映順を変えない)
+        if(world.senseCache.maxAge > 1 && world.senseCache.cellCheck) {
+            world.cells.build(world.entities);
+        }
+        if(domains) {
+            domains->exchange(world, [&](int k) {
+                for(Entity* e : domains->ownedBy(k)) {
+                    if(e->getKind() == EntityKind::Creature) static_cast<Creature*>(e)->prepareObservation();
+                }
+            });
+        } else {
+            packNeighbors();
+        }
+        actionBatch.clear();
+        actors.clear();
+        for(auto& e : world.entities) {
+            e->update(dt);
+            if(!e->isAlive()) continue;
+            Creature* c = dynamic_cast<Creature*>(e.get());
+            if(c) {
+                actors.push_back(c);
+                actionBatch.push(c->getQSlot(), c->getCurrentState(), c->getEpsilon());
+            }
+        }
+        timer.lap(SimPhase::Observe);
+
+        // 行動選択 (ε-greedy を一括計算) → 全個体の移動をまとめて実行
+        actionBatch.select(world.qTables, actionRng);
+        world.bodies.clearActions();
+        for(size_t i=0; i<actors.size(); i++) {
+            actors[i]->setAction(actionBatch.actions[i]);
+        }
+        world.bodies.integrate(dt, Creature::actionMotion(dt));
+        timer.lap(SimPhase::Act);
+
+        // 衝突・捕食判定 (移動後の位置で詰め直し、接触している候補だけ見る)
+        //   領域分割時は帯の索引ができた帯から接触を調べる
+        //   (Sweep and Prune でも帯の索引は作り直す。コマンド適用中の観測が引くため)
+        if(domains && collisionMode == CollisionMode::Query) {
+            domains->exchange(world, [&](int k) { collideStrip(k); });
+        } else {
+            if(domains) domains->exchange(world, nullptr);
+            collideGlobal(cmd);
+        }
+        timer.lap(SimPhase::Collide);
+
+        // 増殖(交配)
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            auto c = std::dynamic_pointer_cast<Creature>(e);
+            if(!c) continue;
+
+            if(c->canReproduce()) {
+                std::shared_ptr<Creature> partner = nullptr;
+                for(auto& e2 : world.entities) {
+                    if(!e2->isAlive()) continue;
+                    if(e2 == e) continue;
+                    auto c2 = std::dynamic_pointer_cast<Creature>(e2);
+                    if(!c2) continue;
+                    if(c2->canReproduce()) {
+                        if(randomInt()%100 < 20) {
+                            partner = c2;
+                            break;
+                        }
+                    }
+                }
+                if(partner) {
+                    cmd.births.push_back(BirthCommand{ c.get(), partner.get() });
+                } else {
+                    // 単独増殖
+                    cmd.births.push_back(BirthCommand{ c.get(), c.get() });
+                }
+            }
+        }
+        timer.lap(SimPhase::Reproduce);
+
+        // 記録したコマンドを決定的な順序で適用
+        // (出生・死亡の反映、共有Qテーブルの保留更新、死亡したEntityの削除)
+        CommitCounts counts = commitCommands(world, commitScratch, scheduler);
+
+        // Plant不足なら補充
+        int plantCount=0;
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            if(std::dynamic_pointer_cast<Plant>(e)) {
+                plantCount++;
+            }
+        }
+        if(plantCount < 15) {
+            for(int i=0; i<5; i++){
+                float x = getRandomFloat(50.f, 750.f);
+                float y = getRandomFloat(50.f, 550.f);
+                auto plant = std::make_shared<Plant>(sf::Vector2f(x,y));
+                world.entities.push_back(plant);
+            }
+        }
+
+        world.tick++;
+        timer.lap(SimPhase::Commit);
+        if(metrics) {
+            metrics->countTick(counts);
+            if(metrics->statsDue(world.tick)) metrics->publishStats(collectStats(), world.tick);
+        }
+    }
+
+    // 衝突判定 (全体の索引で)
+    void collideGlobal(CommandSegment& cmd) {
+        packNeighbors();
+        const NeighborPack& pack = world.neighbors.pack;
+        if(collisionMode == CollisionMode::SweepAndPrune) {
+            sweep.collide(pack, [&](size_t i, size_t j) {
+                if(pack.owner[i]->getKind() == EntityKind::Creature) contact(cmd, pack.owner[i], pack.owner[j]);
+                if(pack.owner[j]->getKind() == EntityKind::Creature) contact(cmd, pack.owner[j], pack.owner[i]);
+            });
+        } else {
+            for(size_t j1=0; j1<pack.size(); j1++) {
+                if(pack.owner[j1]->getKind() != EntityKind::Creature) continue;
+                NeighborProbe probe = { pack.x[j1], pack.y[j1], pack.radius[j1], 0.f, pack.attack[j1] };
+
+                world.neighbors.query(probe, pack.radius[j1] + pack.maxRadius, [&](size_t start, const NeighborMasks& m) {
+                    uint64_t bits = m.collide;
+                    while(bits) {
+                        size_t j2 = start + popLowestBit(bits);
+                        if(j2 == j1) continue;
+                        contact(cmd, pack.owner[j1], pack.owner[j2]);
+                    }
+                    return true;
+                });
+            }
+        }
+    }
+
+    // 衝突判定 (帯 k が所有する個体の接触。コマンドは帯ごとのセグメントへ)
+    void collideStrip(int k) {
+        CommandSegment& seg = world.commands.segment(k);
+        const NeighborIndex& index = world.regions[k];
+        const NeighborPack& own = domains->ownedPack(k);
+        for(size_t i=0; i<own.size(); i++) {
+            if(own.owner[i]->getKind() != EntityKind::Creature) continue;
+            NeighborProbe probe = { own.x[i], own.y[i], own.radius[i], 0.f, own.attack[i] };
+            index.query(probe, own.radius[i] + index.pack.maxRadius, [&](size_t start, const NeighborMasks& m) {
+                uint64_t bits = m.collide;
+                while(bits) {
+                    Entity* e2 = index.pack.owner[start + popLowestBit(bits)];
+                    if(e2 == own.owner[i]) continue;
+                    contact(seg, own.owner[i], e2);
+                }
+                return true;
+            });
+        }
+    }
+
+    // 接触 (c1 から見た e2) を捕食コマンドにする
+    void contact(CommandSegment& cmd, Entity* e1, Entity* e2) {
+        const SimParams& p = world.params;
+        Creature* c1 = static_cast<Creature*>(e1);
+        // Plant
+        if(e2->getKind() == EntityKind::Plant) {
+            cmd.eats.push_back(EatCommand{ c1, e2, p.plantEnergy, p.plantReward, 0.f });
+            return;
+        }
+        // Creature
+        Creature* c2 = static_cast<Creature*>(e2);
+        float atk1 = c1->getAttackPower();
+        float atk2 = c2->getAttackPower();
+        if(atk1 > atk2) {
+            float poisonDmg = 0.f;
+            if(c2->isPoisonous()) {
+                poisonDmg = 12.f * (1.f - c1->getPoisonResistance());
+            }
+            cmd.eats.push_back(EatCommand{ c1, c2, p.preyEnergy, p.predationReward, poisonDmg });
+        } else if(atk1 < atk2) {
+            float poisonDmg = 0.f;
+            if(c1->isPoisonous()) {
+                poisonDmg = 12.f * (1.f - c2->getPoisonResistance());
+            }
+            cmd.eats.push_back(EatCommand{ c2, c1, p.counterEnergy, p.predationReward, poisonDmg });
+        }
+        // 同じ攻撃力の場合は何もしない
+    }
+
+    // 生存している Entity を近傍候補として詰める
+    void packNeighbors() {
+        NeighborPack& pack = world.neighbors.pack;
+        pack.clear();
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            sf::Vector2f pos = e->getPosition();
+            float atk = (e->getKind() == EntityKind::Creature)
+                      ? static_cast<Creature*>(e.get())->getAttackPower() : -1.f;
+            pack.push(e.get(), pos.x, pos.y, e->getCollisionRadius(), atk);
+        }
+        world.neighbors.finish(world.spatialMode);
+    }
+
+    // 描画用スナップショットを作る (生存している Entity のみ)
+    void buildSnapshot(RenderSnapshot& snap) const {
+        snap.items.clear();
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            sf::Vector2f pos = e->getPosition();
+            snap.items.push_back(RenderItem{ pos.x, pos.y, e->getCollisionRadius(), e->getColor(), e->getKind() });
+        }
+        snap.stats = collectStats();
+        snap.tick  = world.tick;
+    }
+
+    SimStats collectStats() const {
+        SimStats st;
+        float totalQ = 0.f;
+        for(auto& e : world.entities){
+            if(!e->isAlive()) continue;
+            auto c = std::dynamic_pointer_cast<Creature>(e);
+            if(c) {
+                st.creatureCount++;
+                totalQ += c->getAverageQ();
+                if(c->getGeneration() > st.maxGeneration) {
+                    st.maxGeneration = c->getGeneration();
+                }
+                st.speciesCount[c->getSpeciesName()]++;
+            }
+            else if(std::dynamic_pointer_cast<Plant>(e)) {
+                st.plantCount++;
+            }
+        }
+        st.averageQ = (st.creatureCount > 0) ? (totalQ / st.creatureCount) : 0.f;
+        return st;
+    }
+
+    //------------------------------------------------------
+    // 島モデル: 生存個体のうち fraction の割合を取り出す
+    //------------------------------------------------------
+    std::vector<Migrant> emigrate(float fraction) {
+        RandomScope scope(random);
+        std::vector<Creature*> pool;
+        for(auto& e : world.entities) {
+            if(!e->isAlive()) continue;
+            Creature* c = dynamic_cast<Creature*>(e.get());
+            if(c) pool.push_back(c);
+        }
+        int count = std::min((int)pool.size(), (int)(fraction * pool.size() + 0.5f));
+        std::vector<Migrant> out;
+        out.reserve(count);
+        for(int i=0; i<count; i++) {
+            // 部分的な Fisher-Yates で重複なく選ぶ
+            int j = i + randomInt() % (int)(pool.size() - i);
+            std::swap(pool[i], pool[j]);
+            out.push_back(pool[i]->emigrate());
+            world.entities.markDead(pool[i]);
+            if(world.lineage.enabled()) {
+                world.lineage.recordDeath(DeathCause::Emigrated, world.tick, pool[i]->id, 0,
+                                          pool[i]->getGenes(), pool[i]->getGeneration(), pool[i]->getLineage());
+            }
+        }
+        world.entities.removeDead();
+        if(metrics) metrics->countDeaths(DeathCause::Emigrated, (uint32_t)count);
+        return out;
+    }
+
+    // 他の島から来た個体を受け入れる
+    void immigrate(const std::vector<Migrant>& migrants) {
+        RandomScope scope(random);
+        for(const Migrant& m : migrants) {
+            auto c = std::make_shared<Creature>(m.genes, m.position, m.color, m.generation, &world, m.lineage);
+            c->immigrate(m);
+            world.entities.push_back(c);
+            if(world.lineage.enabled()) {
+                world.lineage.recordBirth(LineageKind::Immigrant, world.tick, c->id, m.sourceId,
+                                          (uint64_t)m.sourceIsland, m.genes, m.generation, m.lineage);
+            }
+        }
+    }
+
+    //------------------------------------------------------
+    // チェックポイント (テキスト)
+    //   生存個体 (遺伝子・位置・エネルギー・Qテーブルなど移住で運ぶ中身) と植物の位置、tick を保存する
+    //   復元は populate の代わりに使う。乱数系列や向き・感知結果は保存しないので、
+    //   保存した時点から同じ経過を辿るわけではない (集団と学習の状態を引き継ぐためのもの)
+    //     evo-checkpoint 2 ENCODER ACTIONS TABLE_SIZE TICK
+    //     creature GEN LINEAGE ENERGY LIFETIME OFFSPRING X Y R G B SPEED ATTACK POISON LEGS SENSE RESIST Q...
+    //     plant X Y
+    //     end RECORDS
+    //   Qテーブルの並び (状態エンコーダ・行動数) が違うビルドのものは読まない
+    //   末尾の end と件数で途中で切れたファイルを見分ける。書き込みは一時ファイルに書いてから
+    //   rename で置き換えるので、保存中に落ちても前のチェックポイントは壊れない
+    //------------------------------------------------------
+    bool saveCheckpoint(const std::string& path) const {
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp);
+            if(!out) return false;
+            out.precision(9);
+            out << "evo-checkpoint 2 " << Creature::Encoder::name() << " " << QTableStore::NUM_ACTIONS << " "
+                << QTableStore::TABLE_SIZE << " " << world.tick << "\n";
+            uint64_t records = 0;
+            for(auto& e : world.entities) {
+                if(!e->isAlive()) continue;
+                if(e->getKind() == EntityKind::Creature) {
+                    Migrant m = static_cast<const Creature*>(e.get())->toMigrant();
+                    out << "creature " << m.generation << " " << m.lineage << " "
+                        << m.energy << " " << m.lifetime << " " << m.offspringCount << " "
+                        << m.position.x << " " << m.position.y << " "
+                        << (int)m.color.r << " " << (int)m.color.g << " " << (int)m.color.b << " "
+                        << m.genes.speed << " " << m.genes.attack << " " << (m.genes.poison ? 1 : 0) << " "
+                        << m.genes.legs << " " << m.genes.senseRange << " " << m.genes.poisonResistance;
+                    for(float q : m.q) out << " " << q;
+                    out << "\n";
+                } else {
+                    sf::Vector2f pos = e->getPosition();
+                    out << "plant " << pos.x << " " << pos.y << "\n";
+                }
+                records++;
+            }
+            out << "end " << records << "\n";
+            out.close();
+            if(!out) {
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        if(std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // 全体を読んで検証してからワールドに反映する (壊れていれば何も変えずに false)
+    bool restoreCheckpoint(const std::string& path) {
+        std::ifstream in(path);
+        std::string magic, encoder;
+        int version = 0, actions = 0, tableSize = 0;
+        uint64_t tick = 0;
+        if(!(in >> magic >> version) || magic != "evo-checkpoint") {
+            std::cerr << "Not a checkpoint: " << path << "\n";
+            return false;
+        }
+        if(version != 2) {
+            std::cerr << "Unsupported checkpoint version " << version << ": " << path << "\n";
+            return false;
+        }
+        if(!(in >> encoder >> actions >> tableSize >> tick)) {
+            std::cerr << "Broken checkpoint header: " << path << "\n";
+            return false;
+        }
+        if(encoder != Creature::Encoder::name() || actions != QTableStore::NUM_ACTIONS
+           || tableSize != QTableStore::TABLE_SIZE) {
+            std::cerr << "Checkpoint Q table layout (" << encoder << ", " << actions << " actions, "
+                      << tableSize << " values) does not match this build (" << Creature::Encoder::name()
+                      << ", " << QTableStore::NUM_ACTIONS << " actions, " << QTableStore::TABLE_SIZE
+                      << " values): " << path << "\n";
+            return false;
+        }
+
+        std::vector<Migrant> creatures;
+        std::vector<sf::Vector2f> plants;
+        uint64_t records = 0;
+        bool ended = false;
+        std::string kind;
+        while(!ended && in >> kind) {
+            if(kind == "plant") {
+                sf::Vector2f pos;
+                in >> pos.x >> pos.y;
+                if(!in) break;
+                plants.push_back(pos);
+            } else if(kind == "creature") {
+                Migrant m;
+                int r = 0, g = 0, b = 0, poison = 0;
+                m.q.resize(tableSize);
+                in >> m.generation >> m.lineage >> m.energy >> m.lifetime >> m.offspringCount
+                   >> m.position.x >> m.position.y >> r >> g >> b
+                   >> m.genes.speed >> m.genes.attack >> poison >> m.genes.legs
+                   >> m.genes.senseRange >> m.genes.poisonResistance;
+                for(float& q : m.q) in >> q;
+                if(!in) break;
+                m.genes.poison = poison != 0;
+                m.color = sf::Color((sf::Uint8)r, (sf::Uint8)g, (sf::Uint8)b);
+                creatures.push_back(std::move(m));
+            } else if(kind == "end") {
+                uint64_t expected = 0;
+                if(!(in >> expected) || expected != records) break;
+                ended = true;
+                continue;
+            } else {
+                break;
+            }
+            records++;
+        }
+        if(!ended || (in >> kind)) {
+            std::cerr << "Broken or truncated checkpoint: " << path << "\n";
+            return false;
+        }
+
+        RandomScope scope(random);
+        world.tick = tick;
+        for(const sf::Vector2f& pos : plants) {
+            world.entities.push_back(std::make_shared<Plant>(pos));
+        }
+        for(const Migrant& m : creatures) {
+            auto c = std::make_shared<Creature>(m.genes, m.position, m.color, m.generation, &world, m.lineage);
+            c->immigrate(m);
+            world.entities.push_back(c);
+            if(world.lineage.enabled()) {
+                world.lineage.recordBirth(LineageKind::Founder, world.tick, c->id, 0, 0,
+                                          m.genes, m.generation, m.lineage);
+            }
+        }
+        return true;
+    }
+
+    // 現在の集計値 (制御ソケットの stats への応答)
+    void writeStatus(std::ostream& out, const std::string& label) const {
+        SimStats st = collectStats();
+        out << label << "tick=" << world.tick << " creatures=" << st.creatureCount
+            << " plants=" << st.plantCount << " max_gen=" << st.maxGeneration
+            << " avg_q=" << st.averageQ << " species=" << st.speciesCount.size() << "\n";
+        for(const auto& kv : st.speciesCount) {
+            out << label << "species " << kv.first << "=" << kv.second << "\n";
+        }
+    }
+
+private:
+    World world;
+    RandomStream random;
+
+    // 行動選択バッチ
+    ActionBatch actionBatch;
+    std::vector<Creature*> actors;
+    LaneRng actionRng;
+
+    // 代謝パスの出力 (この tick で餓死した個体)
+    std::vector<StarvedRecord> starved;
+
+    // コマンドバッファ適用時の作業領域
+    CommitScratch commitScratch;
+
+    // 衝突判定
+    CollisionMode collisionMode = CollisionMode::Query;
+    SweepAndPrune sweep;
+
+    // 並列化に使うスケジューラ (無ければ出生も直列)
+    TaskScheduler* scheduler = nullptr;
+
+    SimMetrics* metrics = nullptr;
+
+    // 領域分割 (--domains=N, N > 1 の時だけ)
+    std::unique_ptr<TaskScheduler>       ownScheduler;   // options.scheduler が無い時だけ
+    std::unique_ptr<DomainDecomposition> domains;
+};
+
+//----------------------------------------------------------
+// 制御ソケットのチェックポイント・集計値の要求をワールドに対して処理する
+//   suffix: チェックポイントのファイル名の末尾 (島モデルでは ".島番号")
+//   label : 集計値の各行の先頭
+//----------------------------------------------------------
+void serviceControl(ControlRequest& r, const Simulation& sim, const std::string& suffix, const std::string& label) {
+    if(r.kind == ControlRequest::Kind::Checkpoint) {
+        std::string path = (r.path.empty() ? "checkpoint." + std::to_string(sim.getTickCount()) : r.path) + suffix;
+        if(sim.saveCheckpoint(path)) {
+            r.reply += label + "checkpoint " + path + "\n";
+        } else {
+            r.reply += label + "failed to write " + path + "\n";
+            r.failed = true;
+        }
+    } else if(r.kind == ControlRequest::Kind::Stats) {
+        std::ostringstream ss;
+        sim.writeStatus(ss, label);
+        r.reply += ss.str();
+    }
+}
+
+//----------------------------------------------------------
+// 背景描画
+//----------------------------------------------------------
+void drawBackground(sf::RenderTarget& target, sf::Color color) {
+    sf::RectangleShape rect;
+    rect.setSize(sf::Vector2f(target.getSize().x, target.getSize().y));
+    rect.setFillColor(color);
+    rect.setPosition(0.f, 0.f);
+    target.draw(rect);
+}
+
+//----------------------------------------------------------
+// スナップショットの描画
+//   全 Entity の円を1つの頂点配列 (三角形) にまとめて1回で描画する
+//----------------------------------------------------------
+class SnapshotRenderer {
+public:
+    static const int SEGMENTS = 24;   // 円の分割数
+
+    SnapshotRenderer() : vertices(sf::Triangles) {
+        for(int i=0; i<=SEGMENTS; i++) {
+            float t = i * 2.f * 3.14159265f / SEGMENTS;
+            unitX[i] = std::cos(t);
+            unitY[i] = std::sin(t);
+        }
+    }
+
+    void draw(sf::RenderTarget& target, const RenderSnapshot& snap) {
+        drawBackground(target, sf::Color(220,220,220));
+
+        vertices.resize(snap.items.size() * SEGMENTS * 3);
+        size_t v = 0;
+        for(const RenderItem& it : snap.items) {
+            sf::Vector2f center(it.x, it.y);
+            for(int i=0; i<SEGMENTS; i++) {
+                vertices[v++] = sf::Vertex(center, it.color);
+                vertices[v++] = sf::Vertex(sf::Vector2f(it.x + it.radius * unitX[i],     it.y + it.radius * unitY[i]),     it.color);
+                vertices[v++] = sf::Vertex(sf::Vector2f(it.x + it.radius * unitX[i + 1], it.y + it.radius * unitY[i + 1]), it.color);
+            }
+        }
+        target.draw(vertices);
+    }
+
+private:
+    sf::VertexArray vertices;
+    float unitX[SEGMENTS + 1];
+    float unitY[SEGMENTS + 1];
+};
+
+//----------------------------------------------------------
+// 容量付きキュー (満杯なら push が、空なら pop が待つ)
+//----------------------------------------------------------
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t cap) : capacity(std::max<size_t>(1, cap)) {}
+
+    // 満杯の間は待つ。close 後は false を返す
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&]{ return items.size() < capacity || closed; });
+        if(closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // 空の間は待つ。close 後に空になったら false を返す
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&]{ return !items.empty() || closed; });
+        if(items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+};
+
+//----------------------------------------------------------
+// オフスクリーン録画 (ヘッドレス)
+//   N tick ごとに描画用スナップショット (CPU 上のコピー) を容量付きキューへ積む
+//   sf::RenderTexture への描画・画像の取り出し (GPU からの読み戻し)・書き出しは
+//   すべて書き出しスレッドで行うので、シミュレーション側が待つのはキューが満杯の時だけ
+//   書き出しに失敗したら録画を止め、シミュレーションもエラーで終える
+//     png:DIR   : DIR/frame_000000.png の連番
+//     raw:PATH  : RGBA の生データを連結して書き出す ("-" なら標準出力。ffmpeg などへのパイプ用)
+//       例: ./sim --capture=raw:- | ffmpeg -f rawvideo -pix_fmt rgba -s 800x600 -r 30 -i - out.mp4
+//----------------------------------------------------------
+struct CaptureConfig {
+    std::string target;                // --capture
+    int         every     = 2;         // --capture-every (tick)
+    int         queueSize = 8;         // --capture-queue (フレーム数)
+    long long   ticks     = 0;         // --ticks (開始時点から進める tick 数。0 なら絶滅まで)
+    float       dt        = 1.f / 60.f;
+
+    bool enabled() const {
+        return !target.empty();
+    }
+};
+
+class FrameWriter {
+public:
+    explicit FrameWriter(size_t queueSize) : queue(queueSize) {}
+
+    ~FrameWriter() {
+        finish();
+    }
+
+    // 出力先を開き、書き出しスレッドを起動してそのスレッドで描画先を作る
+    bool start(const std::string& target) {
+        if(target.rfind("png:", 0) == 0) {
+            directory = target.substr(4);
+        } else if(target == "raw:-") {
+            rawOut = stdout;
+        } else if(target.rfind("raw:", 0) == 0) {
+            rawOut = std::fopen(target.substr(4).c_str(), "wb");
+            ownsRawOut = true;
+            if(!rawOut) {
+                std::cerr << "Failed to open capture output: " << target.substr(4) << "\n";
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown capture target (use png:DIR or raw:PATH): " << target << "\n";
+            return false;
+        }
+        // 描画先 (GL コンテキスト) は使うスレッドで作る
+        std::promise<bool> ready;
+        std::future<bool> created = ready.get_future();
+        worker = std::thread([this, &ready]{ run(ready); });
+        if(!created.get()) {
+            finish();
+            return false;
+        }
+        return true;
+    }
+
+    // キューが満杯の時だけ待つ (書き出しが失敗して止まっていれば false)
+    bool submit(RenderSnapshot&& frame) {
+        return queue.push(std::move(frame));
+    }
+
+    // 書き出しに失敗したか
+    bool failed() const {
+        return writeFailed.load();
+    }
+
+    // 残りのフレームを書き出して終了
+    void finish() {
+        queue.close();
+        if(worker.joinable()) worker.join();
+        if(rawOut) {
+            if(std::fflush(rawOut) != 0 && !writeFailed.load()) {
+                std::cerr << "Error: failed to flush capture output\n";
+                writeFailed = true;
+            }
+            if(ownsRawOut) std::fclose(rawOut);
+            rawOut = nullptr;
+        }
+    }
+
+    uint64_t framesWritten() const {
+        return written.load();
+    }
+
+private:
+    BoundedQueue<RenderSnapshot> queue;
+    std::thread worker;
+    std::string directory;
+    FILE* rawOut = nullptr;
+    bool ownsRawOut = false;
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> writeFailed{false};
+
+    // 書き出しを止める (以後 submit は false を返す)
+    void fail(const std::string& message) {
+        std::cerr << "Error: " << message << "; capture stopped after "
+                  << written.load() << " frames\n";
+        writeFailed = true;
+        queue.close();
+    }
+
+    void run(std::promise<bool>& ready) {
+        sf::RenderTexture texture;
+        if(!texture.create(WORLD_WIDTH, WORLD_HEIGHT)) {
+            std::cerr << "Failed to create render texture\n";
+            ready.set_value(false);
+            return;
+        }
+        ready.set_value(true);
+        SnapshotRenderer renderer;
+        RenderSnapshot snap;
+        while(queue.pop(snap)) {
+            texture.clear();
+            renderer.draw(texture, snap);
+            texture.display();
+            sf::Image frame = texture.getTexture().copyToImage();
+            if(rawOut) {
+                size_t bytes = (size_t)frame.getSize().x * frame.getSize().y * 4;
+                if(std::fwrite(frame.getPixelsPtr(), 1, bytes, rawOut) != bytes) {
+                    fail("capture output closed or not writable");
+                    break;
+                }
+            } else {
+                char name[32];
+                std::snprintf(name, sizeof(name), "/frame_%06llu.png", (unsigned long long)written.load());
+                if(!frame.saveToFile(directory + name)) {
+                    fail("failed to write " + directory + name);
+                    break;
+                }
+            }
+            written++;
+        }
+    }
+};
+
+int runCapture(const CaptureConfig& cfg, Simulation& sim, RunControl* control = nullptr) {
+    FrameWriter writer(cfg.queueSize);
+    if(!writer.start(cfg.target)) return 1;
+
+    const int every = std::max(1, cfg.every);
+    RunControl::Service service = [&](ControlRequest& r) { serviceControl(r, sim, "", ""); };
+    // --ticks は開始時点 (復元した tick) からの数
+    const uint64_t startTick = sim.getTickCount();
+    while(cfg.ticks == 0 || (long long)(sim.getTickCount() - startTick) < cfg.ticks) {
+        if(control) control->admit(1, cfg.dt, service);
+        sim.step(cfg.dt);
 
-        // ★生存時間を加算
-        lifetime += deltaTime;
+        if(sim.getTickCount() % every == 0) {
+            RenderSnapshot snap;
+            sim.buildSnapshot(snap);
+            if(!writer.submit(std::move(snap))) break;
+        }
 
-        // 時間経過に応じた報酬(微小な負)
-        float reward = -0.002f;
-
-        // エネルギー消費
-        energy -= deltaTime * 0.4f; 
-        if (energy <= 0.f) {
-            alive = false;
-            // ★死亡時(エネルギー切れ)の最終報酬
-            //   早死に & 子孫ゼロだと大きなマイナス
-            //   子孫を残していれば多少緩和
-            float finalReward = -10.f;            // 基本ペナルティ
-            finalReward += offspringCount * 5.f;  // 子孫1体につき +5
-            finalReward += lifetime * 0.1f;       // 長く生きるほど + (0.1 × 秒)
-
-            // 前フレーム分と合算
-            updateQ(reward + finalReward);
-            return;
+        // ログは標準エラーへ (標準出力はパイプに使う)
+        if(sim.getTickCount() % 3600 == 0) {
+            SimStats st = sim.collectStats();
+            std::cerr << "[tick " << sim.getTickCount() << "] creatures=" << st.creatureCount
+                      << " maxGen=" << st.maxGeneration << " frames=" << writer.framesWritten() << "\n";
+            if(st.creatureCount == 0) break;
         }
+    }
+    writer.finish();
+    std::cerr << "Captured " << writer.framesWritten() << " frames\n";
+    if(writer.failed()) {
+        std::cerr << "Error: capture failed; run stopped at tick " << sim.getTickCount() << "\n";
+        return 1;
+    }
+    return 0;
+}
 
-        // 前フレームの行動結果に対する Q値更新
-        updateQ(reward);
+//----------------------------------------------------------
+// 島モデル GA
+//   K 個のワールドをそれぞれ別スレッドで M tick 進め、
+//   その後メインスレッドで個体を移住させる (リング or ランダム) を繰り返す
+//   移住はスレッドを止めた状態で行うので、島同士の同期はこの時だけ
+//----------------------------------------------------------
+struct IslandConfig {
+    int       islands         = 0;       // 0 なら通常の (ウィンドウ) モード
+    int       migrateEvery    = 600;     // 移住間隔 (tick)
+    float     migrateFraction = 0.05f;   // 移住させる割合
+    bool      randomTopology  = false;   // false: リング, true: ランダム
+    long long ticks           = 0;       // 開始時点から進める tick 数 (0 なら全島絶滅まで)
+    std::string lineageLog;              // 系統ログ (島ごとに ".k" を付けたファイル)
+    std::string restore;                 // 復元するチェックポイント (島ごとに ".k" を付けたファイル)
+    float     dt              = 1.f / 60.f;
+};
 
-        // 次状態観測 & 行動選択
-        currentState = observeState();
-        currentAction = selectAction(currentState);
+int runIslands(const IslandConfig& cfg, const WorldOptions& options, uint32_t seed,
+               MetricsServer* monitor = nullptr, RunControl* control = nullptr) {
+    const int K = cfg.islands;
+    std::vector<std::unique_ptr<Simulation>> islands;
+    for(int k=0; k<K; k++) {
+        islands.emplace_back(new Simulation(options, seed + 7919u * (uint32_t)(k + 1)));
+        if(!cfg.lineageLog.empty() &&
+           !islands[k]->openLineageLog(cfg.lineageLog + "." + std::to_string(k))) {
+            return 1;
+        }
+        if(monitor) islands[k]->setMetrics(monitor->track(std::to_string(k)));
+        if(!cfg.restore.empty()) {
+            if(!islands[k]->restoreCheckpoint(cfg.restore + "." + std::to_string(k))) return 1;
+        } else {
+            islands[k]->populate(k * 1000);
+        }
+    }
+    if(monitor && !monitor->start()) return 1;
+    RunControl::Service service = [&](ControlRequest& r) {
+        for(int k=0; k<K; k++) {
+            serviceControl(r, *islands[k], "." + std::to_string(k), "island" + std::to_string(k) + " ");
+        }
+    };
+    RandomStream topology(seed ^ 0x27d4eb2du);
 
-        // 行動実行
-        performAction(currentAction, deltaTime);
+    // --ticks は開始時点からの数。ログには復元した tick を足したワールドの tick を出す
+    const long long startTick = K > 0 ? (long long)islands[0]->getTickCount() : 0;
+    long long done = 0;
+    while(cfg.ticks == 0 || done < cfg.ticks) {
+        long long epoch = cfg.migrateEvery;
+        if(cfg.ticks > 0) epoch = std::min(epoch, cfg.ticks - done);
 
-        // クールダウン時間計測
-        if (reproductionCoolDown > 0.f) {
-            reproductionCoolDown -= deltaTime;
+        // 島ごとに 1 タスク (島の中の帯ごとの処理も同じスケジューラに積まれる)
+        //   制御ソケットがあれば、admit() が許す tick 数ずつ全島を揃えて進める
+        for(long long t=0; t<epoch; ) {
+            long long slice = control ? control->admit(epoch - t, cfg.dt, service) : epoch - t;
+            options.scheduler->parallelFor(0, K, 1, [&](size_t lo, size_t hi) {
+                for(size_t k=lo; k<hi; k++) {
+                    for(long long i=0; i<slice; i++) {
+                        islands[k]->step(cfg.dt);
+                    }
+                }
+            });
+            t += slice;
         }
-    }
+        done += epoch;
 
-    void draw(sf::RenderWindow& window) override {
-        if (alive) {
-            shape.setPosition(position);
-            window.draw(shape);
+        // 移住 (全島から送り出してから受け入れる)
+        if(K > 1 && cfg.migrateFraction > 0.f) {
+            std::vector<std::vector<Migrant>> outgoing(K);
+            for(int k=0; k<K; k++) {
+                outgoing[k] = islands[k]->emigrate(cfg.migrateFraction);
+                for(Migrant& m : outgoing[k]) {
+                    m.sourceIsland = k;
+                }
+            }
+            for(int k=0; k<K; k++) {
+                int dest = (k + 1) % K;
+                if(cfg.randomTopology) {
+                    dest = (k + 1 + (int)(topology.next() % (uint32_t)(K - 1))) % K;
+                }
+                islands[dest]->immigrate(outgoing[k]);
+            }
         }
-    }
 
-    sf::Vector2f getPosition() const override {
-        return position;
+        // ログ
+        int total = 0;
+        std::cout << "[tick " << startTick + done << "]";
+        for(int k=0; k<K; k++) {
+            SimStats st = islands[k]->collectStats();
+            total += st.creatureCount;
+            std::cout << " island" << k << ": creatures=" << st.creatureCount
+                      << " maxGen=" << st.maxGeneration
+                      << " species=" << st.speciesCount.size();
+        }
+        std::cout << std::endl;
+        if(total == 0) {
+            std::cout << "All islands extinct." << std::endl;
+            break;
+        }
     }
+    return 0;
+}
 
-    bool isAlive() const override {
-        return alive;
-    }
+//----------------------------------------------------------
+// パラメータスイープ (ヘッドレス)
+//   パラメータ集合 × シードの全組み合わせをワーカースレッドで並列に実行し、
+//   1 実行につき 1 行の CSV を出力する
+//
+//   パラメータ集合の指定
+//     --sweep=alpha=0.05,0.1;gamma=0.8,0.9   : グリッド (各軸の直積)
+//     --sweep-file=FILE                       : 1 行 1 集合のリスト ("alpha=0.1 gamma=0.9", # はコメント)
+//   両方を指定した場合はリストの各行をさらにグリッドで展開する
+//----------------------------------------------------------
+struct SweepConfig {
+    std::string grid;                 // --sweep
+    std::string listFile;             // --sweep-file
+    std::vector<uint32_t> seeds;      // --seeds (空なら --seed の値)
+    long long   ticks = 36000;        // 1 実行の最大 tick 数 (絶滅したら打ち切り)
+    std::string outFile;              // 出力先 (空なら標準出力)
+    std::string lineageLog;           // 系統ログ (実行ごとに ".run番号" を付けたファイル)
+    float       dt    = 1.f / 60.f;
 
-    float getCollisionRadius() const override {
-        return shape.getRadius();
+    bool enabled() const {
+        return !grid.empty() || !listFile.empty();
     }
+};
 
-    // ★捕食されたときの処理
-    void onEaten() override {
-        alive = false;
-        // 捕食された時のペナルティ
-        // ただし子孫を残していれば多少緩和する
-        float finalReward = -40.f;                // 基本ペナルティ
-        finalReward += offspringCount * 5.f;      // 子孫につき +5
-        finalReward += lifetime * 0.1f;           // 生存時間に応じ +0.1 × 秒
+struct SweepRun {
+    SimParams   params;
+    std::string label;   // "alpha=0.1;gamma=0.9" (変更したパラメータのみ)
+    uint32_t    seed;
+};
 
-        updateQ(finalReward);
+// "name=value" を params に反映し、ラベルに追記
+static bool applyParam(const std::string& assignment, SimParams& params, std::string& label) {
+    size_t eq = assignment.find('=');
+    if(eq == std::string::npos) return false;
+    float* field = params.find(assignment.substr(0, eq));
+    if(!field) return false;
+    try {
+        *field = std::stof(assignment.substr(eq + 1));
+    } catch(const std::exception&) {
+        return false;
     }
+    if(!label.empty()) label += ";";
+    label += assignment;
+    return true;
+}
 
-    // -----------------------------------------------------
-    // GA + RL用
-    // -----------------------------------------------------
-    const Genes& getGenes() const {
-        return genes;
+static std::vector<std::string> splitString(const std::string& text, char sep) {
+    std::vector<std::string> out;
+    std::string item;
+    std::istringstream ss(text);
+    while(std::getline(ss, item, sep)) {
+        if(!item.empty()) out.push_back(item);
     }
+    return out;
+}
 
-    float getAttackPower() const {
-        return genes.attack;
+// "1,2,3" または "1-8" (範囲) を展開
+static std::vector<uint32_t> parseSeeds(const std::string& text) {
+    std::vector<uint32_t> seeds;
+    for(const std::string& item : splitString(text, ',')) {
+        size_t dash = item.find('-');
+        if(dash != std::string::npos && dash > 0) {
+            uint32_t lo = (uint32_t)std::stoul(item.substr(0, dash));
+            uint32_t hi = (uint32_t)std::stoul(item.substr(dash + 1));
+            for(uint64_t v=lo; v<=hi; v++) seeds.push_back((uint32_t)v);   // hi が UINT32_MAX でも止まるように 64bit で数える
+        } else {
+            seeds.push_back((uint32_t)std::stoul(item));
+        }
     }
+    return seeds;
+}
 
-    bool isPoisonous() const {
-        return genes.poison;
+// パラメータ集合 × シードの実行リストを作る (書式エラーなら false)
+static bool buildSweepRuns(const SweepConfig& cfg, std::vector<SweepRun>& runs) {
+    // リスト (無ければ既定値の1集合)
+    std::vector<SweepRun> bases;
+    if(!cfg.listFile.empty()) {
+        std::ifstream in(cfg.listFile);
+        if(!in) {
+            std::cerr << "Failed to open sweep file: " << cfg.listFile << "\n";
+            return false;
+        }
+        std::string line;
+        while(std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream ss(line);
+            std::string assignment;
+            SweepRun run;
+            bool any = false;
+            while(ss >> assignment) {
+                if(!applyParam(assignment, run.params, run.label)) {
+                    std::cerr << "Bad parameter: " << assignment << "\n";
+                    return false;
+                }
+                any = true;
+            }
+            if(any) bases.push_back(run);
+        }
+    } else {
+        bases.push_back(SweepRun());
     }
 
-    float getPoisonResistance() const {
-        return genes.poisonResistance;
+    // グリッド展開
+    for(const std::string& axis : splitString(cfg.grid, ';')) {
+        size_t eq = axis.find('=');
+        if(eq == std::string::npos) {
+            std::cerr << "Bad sweep axis: " << axis << "\n";
+            return false;
+        }
+        std::string name = axis.substr(0, eq);
+        std::vector<std::string> values = splitString(axis.substr(eq + 1), ',');
+        std::vector<SweepRun> expanded;
+        for(const SweepRun& base : bases) {
+            for(const std::string& v : values) {
+                SweepRun run = base;
+                if(!applyParam(name + "=" + v, run.params, run.label)) {
+                    std::cerr << "Bad parameter: " << name << "\n";
+                    return false;
+                }
+                expanded.push_back(run);
+            }
+        }
+        bases.swap(expanded);
     }
 
-    void addEnergy(float amount) {
-        energy += amount;
+    // シード展開
+    for(const SweepRun& base : bases) {
+        for(uint32_t seed : cfg.seeds) {
+            SweepRun run = base;
+            run.seed = seed;
+            if(run.label.empty()) run.label = "default";
+            runs.push_back(run);
+        }
     }
+    return true;
+}
 
-    bool canReproduce() const {
-        return (energy > 50.f && reproductionCoolDown <= 0.f);
+int runSweep(const SweepConfig& cfg, const WorldOptions& options) {
+    if(cfg.ticks <= 0) {
+        std::cerr << "--sweep needs --ticks greater than 0\n";
+        return 1;
     }
+    std::vector<SweepRun> runs;
+    if(!buildSweepRuns(cfg, runs)) return 1;
 
-    void resetReproductionCoolDown() {
-        reproductionCoolDown = 5.f;
+    std::ofstream file;
+    if(!cfg.outFile.empty()) {
+        file.open(cfg.outFile);
+        if(!file) {
+            std::cerr << "Failed to open output: " << cfg.outFile << "\n";
+            return 1;
+        }
     }
+    std::ostream& out = cfg.outFile.empty() ? std::cout : file;
+    out << "run,seed,params,survival_ticks,survival_sec,extinct,max_gen,species,shannon,creatures,avg_q" << std::endl;
 
-    // 交配
-    std::shared_ptr<Creature> reproduceWith(std::shared_ptr<Creature> other) {
-        // 子に与えるエネルギー比: 0.6f
-        float childEnergy = energy * 0.6f;
-        energy *= 0.4f;
-
-        Genes childGenes = Genes::crossoverAndMutate(this->genes, other->genes);
+    TaskScheduler& scheduler = *options.scheduler;
+    std::cerr << "Sweep: " << runs.size() << " runs on "
+              << std::min((int)runs.size(), scheduler.threadCount()) << " threads\n";
 
-        sf::Color c1 = shape.getFillColor();
-        sf::Color c2 = other->shape.getFillColor();
-        sf::Uint8 red   = (sf::Uint8)std::min(255, (c1.r + c2.r)/2 + (rand()%11 - 5));
-        sf::Uint8 green = (sf::Uint8)std::min(255, (c1.g + c2.g)/2 + (rand()%11 - 5));
-        sf::Uint8 blue  = (sf::Uint8)std::min(255, (c1.b + c2.b)/2 + (rand()%11 - 5));
-        sf::Color childColor(red, green, blue, 180);
+    // 1 実行 = 1 タスク (実行ごとに長さが違うので、空いたスレッドが次の実行を取る)
+    //   系統ログを開けなかったら、その実行と以降の実行を行わずにエラーで終える
+    std::mutex outMutex;
+    std::atomic<bool> logFailed(false);
+    scheduler.parallelFor(0, runs.size(), 1, [&](size_t lo, size_t hi) {
+        for(size_t i=lo; i<hi; i++) {
+            const SweepRun& run = runs[i];
+            if(logFailed.load()) return;
 
-        int newGen = std::max(this->generation, other->generation) + 1;
+            Simulation sim(options, run.seed, run.params);
+            if(!cfg.lineageLog.empty() && !sim.openLineageLog(cfg.lineageLog + "." + std::to_string(i))) {
+                logFailed = true;
+                return;
+            }
+            sim.populate(0);
 
-        auto child = std::make_shared<Creature>(childGenes, this->position, childColor, newGen, pAllEntities);
-        child->energy = childEnergy;
+            // 最大世代は 1 秒 (60 tick) ごとに観測
+            int maxGen = 0;
+            bool extinct = false;
+            SimStats st;
+            while((long long)sim.getTickCount() < cfg.ticks) {
+                sim.step(cfg.dt);
+                if(sim.getTickCount() % 60 == 0 || (long long)sim.getTickCount() == cfg.ticks) {
+                    st = sim.collectStats();
+                    maxGen = std::max(maxGen, st.maxGeneration);
+                    if(st.creatureCount == 0) {
+                        extinct = true;
+                        break;
+                    }
+                }
+            }
 
-        // Qテーブルの継承
-        child->inheritQ(*this, *other);
+            // 種の多様性 (Shannon 指数)
+            float shannon = 0.f;
+            for(const auto& kv : st.speciesCount) {
+                float q = (float)kv.second / st.creatureCount;
+                shannon -= q * std::log(q);
+            }
 
-        // ★子孫を増やした数をカウント
-        this->offspringCount += 1; 
-        if (other.get() != this) {
-            other->offspringCount += 1;
+            std::lock_guard<std::mutex> lock(outMutex);
+            out << i << "," << run.seed << "," << run.label << ","
+                << sim.getTickCount() << "," << sim.getTickCount() * cfg.dt << ","
+                << (extinct ? 1 : 0) << "," << maxGen << ","
+                << st.speciesCount.size() << "," << shannon << ","
+                << st.creatureCount << "," << st.averageQ << std::endl;
         }
-
-        return child;
+    });
+    if(logFailed.load()) {
+        std::cerr << "Sweep stopped: lineage log could not be opened\n";
+        return 1;
     }
+    return 0;
+}
 
-    // ポジティブ報酬付与
-    void givePositiveReward(float r) {
-        updateQ(r);
-    }
+//----------------------------------------------------------
+// 系統ログの解析 (オフライン)
+//   ログをメモリマップして先頭から1回だけ読み、以下の CSV を出力する
+//     PREFIX.species.csv   : 一定 tick ごとの種族別個体数
+//     PREFIX.survival.csv  : 一定 tick ごとの生存系統数・個体数と出生/死亡数
+//     PREFIX.lineages.csv  : 系統 (始祖) ごとの出現・絶滅 tick、出生数、最大世代
+//     PREFIX.traits.csv    : 世代ごとの遺伝子の平均
+//     PREFIX.predation.csv : 捕食者の種族 × 被食者の種族 の捕食回数
+//   保持するのは生存個体・種族・系統・世代の数に比例する集計だけで、
+//   読み終えた領域は随時ページキャッシュから外すのでファイルサイズには依存しない
+//----------------------------------------------------------
+struct AnalyzeConfig {
+    std::string input;                 // --analyze
+    std::string outPrefix;             // --analyze-out (空なら入力ファイル名)
+    long long   interval = 600;        // --analyze-interval (tick)
+};
 
-    // 世代を返す
-    int getGeneration() const {
-        return generation;
+int runAnalyze(const AnalyzeConfig& cfg) {
+    int fd = ::open(cfg.input.c_str(), O_RDONLY);
+    if(fd < 0) {
+        std::cerr << "Failed to open lineage log: " << cfg.input << "\n";
+        return 1;
     }
-
-    // Qテーブルの平均値を返す (学習状況をざっくり見る指標)
-    float getAverageQ() const {
-        float sum = 0.f;
-        for(int s=0; s<NUM_STATES; s++){
-            for(int a=0; a<NUM_ACTIONS; a++){
-                sum += Q[s][a];
-            }
-        }
-        return sum / (NUM_STATES * NUM_ACTIONS);
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LineageHeader)) {
+        std::cerr << "Not a lineage log: " << cfg.input << "\n";
+        ::close(fd);
+        return 1;
     }
+    const size_t fileSize = (size_t)st.st_size;
+    void* map = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED) {
+        std::cerr << "Failed to map lineage log: " << cfg.input << "\n";
+        return 1;
+    }
+    ::madvise(map, fileSize, MADV_SEQUENTIAL);
+    const char* base = static_cast<const char*>(map);
 
-    // “種族”名を返す
-    std::string getSpeciesName() const {
-        std::string speedCat;
-        if(genes.speed < 60.f)         speedCat = "Slow";
-        else if(genes.speed < 120.f)   speedCat = "Mid";
-        else                           speedCat = "Fast";
-
-        std::string attackCat;
-        if(genes.attack < 10.f)        attackCat = "LowAtk";
-        else if(genes.attack < 30.f)   attackCat = "MedAtk";
-        else                           attackCat = "HighAtk";
-
-        std::string poisonCat = genes.poison ? "Poison" : "NonPois";
-
-        std::string legsStr = "Leg" + std::to_string(genes.legs);
-
-        std::string resistCat;
-        if(genes.poisonResistance < 0.33f)      resistCat = "LowRes";
-        else if(genes.poisonResistance < 0.66f) resistCat = "MidRes";
-        else                                    resistCat = "HighRes";
-
-        return speedCat + "_" + attackCat + "_" + poisonCat + "_" + legsStr + "_" + resistCat;
+    LineageHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if(std::memcmp(header.magic, "EVOLIN1", 8) != 0 || header.recordSize != sizeof(LineageRecord)) {
+        std::cerr << "Unsupported lineage log format: " << cfg.input << "\n";
+        ::munmap(map, fileSize);
+        return 1;
     }
 
-private:
-    //------------------------------------------------------
-    // 親の Q テーブルを引き継ぐ
-    //------------------------------------------------------
-    void inheritQ(const Creature& p1, const Creature& p2) {
-        for(int s=0; s<NUM_STATES; s++){
-            for(int a=0; a<NUM_ACTIONS; a++){
-                float val = 0.5f * (p1.Q[s][a] + p2.Q[s][a]);
-                val += getRandomFloat(-0.1f, 0.1f);
+    const std::string prefix = cfg.outPrefix.empty() ? cfg.input : cfg.outPrefix;
+    std::ofstream speciesOut(prefix + ".species.csv");
+    std::ofstream survivalOut(prefix + ".survival.csv");
+    std::ofstream lineagesOut(prefix + ".lineages.csv");
+    std::ofstream traitsOut(prefix + ".traits.csv");
+    std::ofstream predationOut(prefix + ".predation.csv");
+    if(!speciesOut || !survivalOut || !lineagesOut || !traitsOut || !predationOut) {
+        std::cerr << "Failed to create output files: " << prefix << ".*.csv\n";
+        ::munmap(map, fileSize);
+        return 1;
+    }
+    speciesOut   << "tick,species,count\n";
+    survivalOut  << "tick,lineages_alive,creatures_alive,births,starved,eaten,emigrated,immigrants\n";
+    lineagesOut  << "lineage,founded_tick,extinct_tick,births,max_generation,peak_alive\n";
+    traitsOut    << "generation,count,speed,attack,sense_range,poison_resistance,legs,poison\n";
+    predationOut << "predator_species,prey_species,count\n";
 
-                if(val > 50.f) val = 50.f;
-                if(val < -50.f) val = -50.f;
+    // 集計状態
+    struct LineageStats {
+        uint64_t founded = 0;
+        int64_t  extinct = -1;
+        uint64_t births  = 0;
+        uint32_t maxGeneration = 0;
+        int      alive = 0;
+        int      peak  = 0;
+    };
+    struct TraitSum {
+        uint64_t count = 0;
+        double speed = 0, attack = 0, senseRange = 0, poisonResistance = 0, legs = 0, poison = 0;
+    };
+    std::unordered_map<uint64_t, uint32_t> aliveSpecies;   // 生存個体の ID → 種族キー (捕食者の種族用)
+    std::map<uint32_t, int>               speciesCount;
+    std::map<int, LineageStats>           lineages;
+    std::vector<TraitSum>                 traits;
+    std::map<std::pair<uint32_t, uint32_t>, uint64_t> predation;
+    uint64_t births = 0, starved = 0, eaten = 0, emigrated = 0, immigrants = 0;
+    int lineagesAlive = 0;
 
-                this->Q[s][a] = val;
+    auto emitSnapshot = [&](uint64_t tick) {
+        for(const auto& kv : speciesCount) {
+            if(kv.second > 0) {
+                speciesOut << tick << "," << Genes::speciesName((int)kv.first) << "," << kv.second << "\n";
             }
         }
-    }
+        survivalOut << tick << "," << lineagesAlive << "," << aliveSpecies.size() << ","
+                    << births << "," << starved << "," << eaten << ","
+                    << emigrated << "," << immigrants << "\n";
+        births = starved = eaten = emigrated = immigrants = 0;
+    };
 
-    //------------------------------------------------------
-    // 状態観測(周囲をチェック)
-    //------------------------------------------------------
-    int observeState() {
-        bool foodNear = false;
-        bool predatorNear = false;
+    const long long interval = std::max(1LL, cfg.interval);
+    uint64_t nextEmit = 0;
+    uint64_t lastTick = 0;
+    uint64_t records  = 0;
+    size_t   released = 0;                          // ページキャッシュから外した位置
+    const size_t releaseChunk = (size_t)256 << 20;
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
 
-        if (!pAllEntities) {
-            // 参照がなければ適当に
-            if (rand()%100 < 8)  foodNear = true;
-            if (rand()%100 < 5)  predatorNear = true;
-        } else {
-            float sr2 = genes.senseRange * genes.senseRange; 
-            for (auto& e : *pAllEntities) {
-                if(!e->isAlive()) continue;
-                if(e.get() == this) continue;
-                float dist2 = distance2(this->position, e->getPosition());
-                if(dist2 > sr2) continue; 
-
-                // Plant判定
-                auto plant = std::dynamic_pointer_cast<Plant>(e);
-                if(plant) {
-                    foodNear = true;
-                    continue;
+    for(size_t off = sizeof(LineageHeader); off + sizeof(LineageRecord) <= fileSize; off += sizeof(LineageRecord)) {
+        LineageRecord r;
+        std::memcpy(&r, base + off, sizeof(r));
+        if(r.kind == 0) break;   // 異常終了したログの未使用領域
+        records++;
+
+        // tick nextEmit の記録を全て読み終えたら、その時点の集計を出力
+        while(r.tick > nextEmit) {
+            emitSnapshot(nextEmit);
+            nextEmit += interval;
+        }
+        lastTick = r.tick;
+
+        LineageStats& ls = lineages[r.lineage];
+        switch((LineageKind)r.kind) {
+            case LineageKind::Founder:
+            case LineageKind::Birth:
+            case LineageKind::Immigrant: {
+                if(ls.alive == 0) {
+                    if(ls.births == 0 && ls.extinct < 0) ls.founded = r.tick;
+                    ls.extinct = -1;
+                    lineagesAlive++;
                 }
-                // Creature判定
-                auto c2 = std::dynamic_pointer_cast<Creature>(e);
-                if(c2) {
-                    if(c2->getAttackPower() < this->getAttackPower()) {
-                        foodNear = true;
-                    }
-                    else if(c2->getAttackPower() > this->getAttackPower()) {
-                        predatorNear = true;
+                ls.alive++;
+                ls.peak = std::max(ls.peak, ls.alive);
+                ls.maxGeneration = std::max(ls.maxGeneration, r.generation);
+                aliveSpecies[r.id] = r.species;
+                speciesCount[r.species]++;
+                if(r.kind == (uint8_t)LineageKind::Immigrant) {
+                    immigrants++;
+                    break;
+                }
+                ls.births++;
+                if(r.kind == (uint8_t)LineageKind::Birth) births++;
+                if(traits.size() <= r.generation) traits.resize(r.generation + 1);
+                TraitSum& t = traits[r.generation];
+                Genes g = unpackGenes(r);
+                t.count++;
+                t.speed            += g.speed;
+                t.attack           += g.attack;
+                t.senseRange       += g.senseRange;
+                t.poisonResistance += g.poisonResistance;
+                t.legs             += g.legs;
+                t.poison           += g.poison ? 1 : 0;
+                break;
+            }
+            case LineageKind::Death: {
+                if(ls.alive > 0 && --ls.alive == 0) {
+                    ls.extinct = (int64_t)r.tick;
+                    lineagesAlive--;
+                }
+                speciesCount[r.species]--;
+                aliveSpecies.erase(r.id);
+                switch((DeathCause)r.cause) {
+                    case DeathCause::Starved:   starved++;   break;
+                    case DeathCause::Emigrated: emigrated++; break;
+                    case DeathCause::Eaten: {
+                        eaten++;
+                        auto it = aliveSpecies.find(r.other1);
+                        if(it != aliveSpecies.end()) {
+                            predation[std::make_pair(it->second, r.species)]++;
+                        }
+                        break;
                     }
+                    default: break;
                 }
-                if(foodNear && predatorNear) break;
+                break;
             }
+            default:
+                break;
         }
 
-        int s = 0;
-        if(foodNear)     s |= 1; // bit0
-        if(predatorNear) s |= 2; // bit1
-        return s; // 0..3
+        // 読み終えた領域をページキャッシュから外す (メモリ使用量を一定に保つ)
+        if(off - released >= releaseChunk) {
+            size_t end = off & ~(size_t)(pageSize - 1);
+            ::madvise(const_cast<char*>(base) + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
     }
+    emitSnapshot(lastTick);
+    ::munmap(map, fileSize);
 
-    //------------------------------------------------------
-    // 行動選択(ε-greedy)
-    //------------------------------------------------------
-    int selectAction(int state) {
-        if ((float)rand()/RAND_MAX < epsilon) {
-            return rand() % NUM_ACTIONS;
-        } else {
-            float maxQ = Q[state][0];
-            int bestA = 0;
-            for(int a=1; a<NUM_ACTIONS; a++){
-                if(Q[state][a] > maxQ){
-                    maxQ = Q[state][a];
-                    bestA = a;
-                }
-            }
-            return bestA;
-        }
+    for(const auto& kv : lineages) {
+        const LineageStats& ls = kv.second;
+        lineagesOut << kv.first << "," << ls.founded << ",";
+        if(ls.extinct >= 0) lineagesOut << ls.extinct;
+        lineagesOut << "," << ls.births << "," << ls.maxGeneration << "," << ls.peak << "\n";
+    }
+    for(size_t gen=0; gen<traits.size(); gen++) {
+        const TraitSum& t = traits[gen];
+        if(t.count == 0) continue;
+        double n = (double)t.count;
+        traitsOut << gen << "," << t.count << ","
+                  << t.speed / n << "," << t.attack / n << "," << t.senseRange / n << ","
+                  << t.poisonResistance / n << "," << t.legs / n << "," << t.poison / n << "\n";
+    }
+    for(const auto& kv : predation) {
+        predationOut << Genes::speciesName((int)kv.first.first) << ","
+                     << Genes::speciesName((int)kv.first.second) << "," << kv.second << "\n";
     }
 
-    //------------------------------------------------------
-    // Q値更新
-    //------------------------------------------------------
-    void updateQ(float reward) {
-        int s = currentState;
-        int a = currentAction;
+    std::cerr << "Analyzed " << records << " records up to tick " << lastTick
+              << " (" << lineages.size() << " lineages) -> " << prefix << ".*.csv\n";
+    return 0;
+}
+
+//----------------------------------------------------------
+// メイン
+//----------------------------------------------------------
+int main(int argc, char** argv)
+{
+    uint32_t seed = (uint32_t)time(NULL);
 
-        int sNext = observeState();
-        float maxQNext = Q[sNext][0];
-        for(int i=1; i<NUM_ACTIONS; i++){
-            if(Q[sNext][i] > maxQNext){
-                maxQNext = Q[sNext][i];
+    // コマンドライン引数
+    WorldOptions options;
+    IslandConfig islandConfig;
+    SweepConfig sweepConfig;
+    AnalyzeConfig analyzeConfig;
+    CaptureConfig captureConfig;
+    std::string lineageLog;
+    int  jobs = 0;                // タスクスケジューラのスレッド数 (0 ならコア数)
+    bool pinThreads = false;
+    bool schedulerStats = false;
+    std::string metricsListen;    // 計測値の公開先 (空なら公開しない)
+    std::string controlListen;    // 制御ソケット (空なら使わない)
+    std::string restorePath;      // 初期配置の代わりに読むチェックポイント
+    for(int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        std::string val = (arg.find('=') != std::string::npos) ? arg.substr(arg.find('=') + 1) : "";
+        // 数値の変換 (std::stoi など) に失敗したら使い方のエラーにする
+        try {
+            if(arg == "--q-share=species") {
+                options.qShare = QShareMode::Species;
+            } else if(arg == "--q-share=lineage") {
+                options.qShare = QShareMode::Lineage;
+            } else if(arg == "--q-share=none") {
+                options.qShare = QShareMode::PerCreature;
+            } else if(arg == "--removal=erase") {
+                options.removal = RemovalStrategy::EraseRemove;
+            } else if(arg == "--removal=swap") {
+                options.removal = RemovalStrategy::SwapAndPop;
+            } else if(arg == "--removal=tombstone") {
+                options.removal = RemovalStrategy::Tombstone;
+            } else if(arg == "--spatial=grid") {
+                options.spatial = SpatialMode::Grid;
+            } else if(arg == "--spatial=brute") {
+                options.spatial = SpatialMode::BruteForce;
+            } else if(arg == "--collision=query") {
+                options.collision = CollisionMode::Query;
+            } else if(arg == "--collision=sap") {
+                options.collision = CollisionMode::SweepAndPrune;
+            } else if(arg.rfind("--domains=", 0) == 0) {
+                options.domains = std::max(1, std::stoi(val));
+            } else if(arg == "--pin-threads") {
+                pinThreads = true;
+            } else if(arg == "--scheduler-stats") {
+                schedulerStats = true;
+            } else if(arg.rfind("--sense-max-age=", 0) == 0) {
+                options.senseCache.maxAge = std::max(1, std::stoi(val));
+            } else if(arg.rfind("--sense-move-limit=", 0) == 0) {
+                options.senseCache.moveLimit = std::stof(val);
+            } else if(arg == "--sense-cell-check=0") {
+                options.senseCache.cellCheck = false;
+            } else if(arg == "--sense-cell-check=1") {
+                options.senseCache.cellCheck = true;
+            } else if(arg.rfind("--seed=", 0) == 0) {
+                seed = (uint32_t)std::stoul(val);
+            } else if(arg.rfind("--islands=", 0) == 0) {
+                islandConfig.islands = std::max(0, std::stoi(val));
+            } else if(arg.rfind("--migrate-every=", 0) == 0) {
+                islandConfig.migrateEvery = std::max(1, std::stoi(val));
+            } else if(arg.rfind("--migrate-fraction=", 0) == 0) {
+                islandConfig.migrateFraction = std::stof(val);
+            } else if(arg == "--topology=ring") {
+                islandConfig.randomTopology = false;
+            } else if(arg == "--topology=random") {
+                islandConfig.randomTopology = true;
+            } else if(arg.rfind("--ticks=", 0) == 0) {
+                islandConfig.ticks = std::stoll(val);
+                sweepConfig.ticks = islandConfig.ticks;
+                captureConfig.ticks = islandConfig.ticks;
+            } else if(arg.rfind("--capture=", 0) == 0) {
+                captureConfig.target = val;
+            } else if(arg.rfind("--capture-every=", 0) == 0) {
+                captureConfig.every = std::stoi(val);
+            } else if(arg.rfind("--capture-queue=", 0) == 0) {
+                captureConfig.queueSize = std::stoi(val);
+            } else if(arg.rfind("--sweep=", 0) == 0) {
+                sweepConfig.grid = val;
+            } else if(arg.rfind("--sweep-file=", 0) == 0) {
+                sweepConfig.listFile = val;
+            } else if(arg.rfind("--seeds=", 0) == 0) {
+                sweepConfig.seeds = parseSeeds(val);
+            } else if(arg.rfind("--jobs=", 0) == 0) {
+                jobs = std::stoi(val);
+            } else if(arg.rfind("--analyze=", 0) == 0) {
+                analyzeConfig.input = val;
+            } else if(arg.rfind("--analyze-out=", 0) == 0) {
+                analyzeConfig.outPrefix = val;
+            } else if(arg.rfind("--analyze-interval=", 0) == 0) {
+                analyzeConfig.interval = std::stoll(val);
+            } else if(arg.rfind("--lineage-log=", 0) == 0) {
+                lineageLog = val;
+            } else if(arg.rfind("--metrics=", 0) == 0) {
+                metricsListen = val;
+            } else if(arg.rfind("--control=", 0) == 0) {
+                controlListen = val;
+            } else if(arg.rfind("--restore=", 0) == 0) {
+                restorePath = val;
+            } else if(arg.rfind("--out=", 0) == 0) {
+                sweepConfig.outFile = val;
+            } else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                return 1;
             }
+        } catch(const std::exception&) {
+            std::cerr << "Bad value for option: " << arg << "\n";
+            return 1;
         }
-        float oldQ = Q[s][a];
-        float newQ = oldQ + alpha * (reward + gamma * maxQNext - oldQ);
-        Q[s][a] = newQ;
     }
+    // メインスレッドの乱数系列は --seed を反映してから初期化する
+    seedRandom(seed);
 
-    //------------------------------------------------------
-    // 行動実行
-    //------------------------------------------------------
-    void performAction(int action, float deltaTime) {
-        float speedVal = genes.speed; 
-        switch(action){
-            case 0: {
-                // 前進
-                float rad = direction * 3.14159f / 180.f;
-                position.x += cos(rad) * speedVal * deltaTime;
-                position.y += sin(rad) * speedVal * deltaTime;
-            } break;
-            case 1: {
-                // 左旋回
-                direction -= 90.f * deltaTime;
-            } break;
-            case 2: {
-                // 右旋回
-                direction += 90.f * deltaTime;
-            } break;
-            case 3:
-            default: {
-                // 停止
-            } break;
-        }
+    if(!analyzeConfig.input.empty()) {
+        return runAnalyze(analyzeConfig);
+    }
+
+    islandConfig.lineageLog = lineageLog;
+    islandConfig.restore    = restorePath;
+    sweepConfig.lineageLog  = lineageLog;
 
-        // 画面外に出ないようバウンド
-        if (position.x < 0.f)    { position.x = 0.f;    direction += 180.f; }
-        if (position.x > 800.f)  { position.x = 800.f;  direction += 180.f; }
-        if (position.y < 0.f)    { position.y = 0.f;    direction += 180.f; }
-        if (position.y > 600.f)  { position.y = 600.f;  direction += 180.f; }
+    // 並列に動くフェーズ (スイープの各実行・島・帯ごとの処理) はすべてこのスケジューラに投げる
+    TaskScheduler scheduler(jobs > 0 ? jobs : std::max(1, (int)std::thread::hardware_concurrency()), pinThreads);
+    options.scheduler = &scheduler;
+    auto finish = [&](int status) {
+        if(schedulerStats) scheduler.report(std::cerr);
+        return status;
+    };
+
+    // 計測値の公開 (計測するワールドは各モードが登録してから start する)
+    std::unique_ptr<MetricsServer> monitor;
+    if(!metricsListen.empty()) monitor.reset(new MetricsServer(metricsListen));
+
+    // 制御ソケット (スイープ以外。コマンドは各モードの tick の境目で反映する)
+    std::unique_ptr<RunControl> control;
+    if(!controlListen.empty() && !sweepConfig.enabled()) {
+        control.reset(new RunControl(controlListen));
+        if(!control->start()) return 1;
     }
-};
 
-//----------------------------------------------------------
-// 背景描画
-//----------------------------------------------------------
-void drawBackground(sf::RenderWindow& window, sf::Color color) {
-    sf::RectangleShape rect;
-    rect.setSize(sf::Vector2f(window.getSize().x, window.getSize().y));
-    rect.setFillColor(color);
-    rect.setPosition(0.f, 0.f);
-    window.draw(rect);
-}
+    if(sweepConfig.enabled()) {
+        if(monitor) std::cerr << "--metrics is not available with --sweep (ignored)\n";
+        if(!controlListen.empty()) std::cerr << "--control is not available with --sweep (ignored)\n";
+        if(!restorePath.empty()) std::cerr << "--restore is not available with --sweep (ignored)\n";
+        if(sweepConfig.seeds.empty()) sweepConfig.seeds.push_back(seed);
+        return finish(runSweep(sweepConfig, options));
+    }
 
-//----------------------------------------------------------
-// メイン
-//----------------------------------------------------------
-int main()
-{
-    srand((unsigned)time(NULL));
+    if(islandConfig.islands > 0) {
+        return finish(runIslands(islandConfig, options, seed, monitor.get(), control.get()));
+    }
+
+    if(captureConfig.enabled()) {
+        Simulation sim(options, seed);
+        if(!lineageLog.empty() && !sim.openLineageLog(lineageLog)) {
+            return 1;
+        }
+        if(monitor) {
+            sim.setMetrics(monitor->track("0"));
+            if(!monitor->start()) return 1;
+        }
+        if(!restorePath.empty()) {
+            if(!sim.restoreCheckpoint(restorePath)) return 1;
+        } else {
+            sim.populate(0);
+        }
+        return finish(runCapture(captureConfig, sim, control.get()));
+    }
 
     sf::RenderWindow window(sf::VideoMode(800, 600), "GA + RL Evolution");
     window.setFramerateLimit(60);
@@ -568,49 +6007,54 @@ int main()
         std::cerr << "Warning: Failed to load font. Text will not be visible.\n";
     }
 
-    // Entityコンテナ
-    std::vector<std::shared_ptr<Entity>> entities;
-
-    // 初期Creature
-    for(int i=0; i<8; i++){
-        Genes g;
-        g.speed           = getRandomFloat(30.f, 70.f);
-        g.attack          = getRandomFloat(0.f, 5.f);
-        g.poison          = (rand()%100 < 30);
-        g.legs            = rand()%4 + 1;
-        g.senseRange      = getRandomFloat(50.f, 150.f);
-        g.poisonResistance= getRandomFloat(0.f, 1.f); 
-
-        float x = getRandomFloat(100.f, 700.f);
-        float y = getRandomFloat(100.f, 500.f);
-
-        sf::Color color(
-            100 + rand()%156,
-            100 + rand()%156,
-            100 + rand()%156,
-            180
-        );
-        auto c = std::make_shared<Creature>(g, sf::Vector2f(x,y), color, 0, &entities);
-        entities.push_back(c);
+    // シミュレーション (ワールドと tick 処理)
+    Simulation sim(options, seed);
+    if(!lineageLog.empty() && !sim.openLineageLog(lineageLog)) {
+        return 1;
     }
-
-    // 初期Plant (30個)
-    for(int i = 0; i < 30; i++){
-        float x = getRandomFloat(50.f, 750.f);
-        float y = getRandomFloat(50.f, 550.f);
-        auto plant = std::make_shared<Plant>(sf::Vector2f(x,y));
-        entities.push_back(plant);
+    if(monitor) {
+        sim.setMetrics(monitor->track("0"));
+        if(!monitor->start()) return 1;
     }
+    if(!restorePath.empty()) {
+        if(!sim.restoreCheckpoint(restorePath)) return 1;
+    } else {
+        sim.populate(0);
+    }
+
+    // シミュレーションは専用スレッドで固定 dt のまま全速で回し、
+    // 描画 (このスレッド) には最新のスナップショットだけを渡す
+    const float simDt = 1.f / 60.f;
+    const auto publishInterval = std::chrono::milliseconds(8);
+    TripleBuffer<RenderSnapshot> snapshots;
+    std::atomic<bool> simRunning(true);
+    std::atomic<uint64_t> simTicks(0);
+    RunControl::Service service = [&](ControlRequest& r) { serviceControl(r, sim, "", ""); };
+    std::thread simThread([&]() {
+        auto lastPublish = std::chrono::steady_clock::now() - publishInterval;
+        while(simRunning.load(std::memory_order_relaxed)) {
+            if(control) control->admit(1, simDt, service);
+            sim.step(simDt);
+            simTicks.store(sim.getTickCount(), std::memory_order_relaxed);
+            auto now = std::chrono::steady_clock::now();
+            if(now - lastPublish >= publishInterval) {
+                sim.buildSnapshot(snapshots.writeBuffer());
+                snapshots.publish();
+                lastPublish = now;
+            }
+        }
+    });
+
+    SnapshotRenderer renderer;
 
     // FPS計測用
     sf::Clock frameClock;
     float fps = 0.f;
+    float tps = 0.f;
     float fpsTimer = 0.f;
     float fpsInterval = 0.5f;
     int frameCount = 0;
-
-    // アプリ開始からの経過時間
-    float totalElapsedTime = 0.0f; 
+    uint64_t lastTicks = 0;
 
     while (window.isOpen()) {
         sf::Event ev;
@@ -621,138 +6065,24 @@ int main()
         }
 
         float dt = frameClock.restart().asSeconds();
-        totalElapsedTime += dt;
 
-        // FPS 計測
+        // FPS / 1秒あたりの tick 数 計測
         fpsTimer += dt;
         frameCount++;
         if(fpsTimer >= fpsInterval){
+            uint64_t ticks = simTicks.load(std::memory_order_relaxed);
             fps = frameCount / fpsTimer;
+            tps = (ticks - lastTicks) / fpsTimer;
+            lastTicks = ticks;
             frameCount = 0;
             fpsTimer = 0.f;
         }
 
-        // Update
-        for(auto& e : entities) {
-            e->update(dt);
-        }
-
-        // 衝突・捕食判定
-        for(auto& e1 : entities) {
-            if(!e1->isAlive()) continue;
-            auto c1 = std::dynamic_pointer_cast<Creature>(e1);
-            if(!c1) continue;
-
-            for(auto& e2 : entities) {
-                if(!e2->isAlive()) continue;
-                if(e1 == e2) continue;
-                float dx = c1->getPosition().x - e2->getPosition().x;
-                float dy = c1->getPosition().y - e2->getPosition().y;
-                float dist = std::sqrt(dx*dx + dy*dy);
-                if(dist < (c1->getCollisionRadius() + e2->getCollisionRadius())) {
-                    // Plant
-                    auto plant = std::dynamic_pointer_cast<Plant>(e2);
-                    if(plant) {
-                        plant->onEaten();
-                        c1->addEnergy(15.f);
-                        c1->givePositiveReward(5.f);
-                    } else {
-                        // Creature
-                        auto c2 = std::dynamic_pointer_cast<Creature>(e2);
-                        if(c2) {
-                            float atk1 = c1->getAttackPower();
-                            float atk2 = c2->getAttackPower();
-                            if(atk1 > atk2) {
-                                c2->onEaten();
-                                c1->addEnergy(25.f);
-                                c1->givePositiveReward(10.f);
-                                if(c2->isPoisonous()) {
-                                    float poisonDmg = 12.f * (1.f - c1->getPoisonResistance());
-                                    c1->addEnergy(-poisonDmg);
-                                }
-                            } else if(atk1 < atk2) {
-                                c1->onEaten();
-                                c2->addEnergy(30.f);
-                                c2->givePositiveReward(10.f);
-                                if(c1->isPoisonous()) {
-                                    float poisonDmg = 12.f * (1.f - c2->getPoisonResistance());
-                                    c2->addEnergy(-poisonDmg);
-                                }
-                            }
-                            // 同じ攻撃力の場合は何もしない
-                        }
-                    }
-                }
-            }
-        }
-
-        // 増殖(交配)
-        std::vector<std::shared_ptr<Entity>> newEntities;
-        for(auto& e : entities) {
-            if(!e->isAlive()) continue;
-            auto c = std::dynamic_pointer_cast<Creature>(e);
-            if(!c) continue;
-
-            if(c->canReproduce()) {
-                std::shared_ptr<Creature> partner = nullptr;
-                for(auto& e2 : entities) {
-                    if(!e2->isAlive()) continue;
-                    if(e2 == e) continue;
-                    auto c2 = std::dynamic_pointer_cast<Creature>(e2);
-                    if(!c2) continue;
-                    if(c2->canReproduce()) {
-                        if(rand()%100 < 20) {
-                            partner = c2;
-                            break;
-                        }
-                    }
-                }
-                std::shared_ptr<Creature> child = nullptr;
-                if(partner) {
-                    child = c->reproduceWith(partner);
-                    partner->resetReproductionCoolDown();
-                } else {
-                    // 単独増殖
-                    child = c->reproduceWith(c);
-                }
-                c->resetReproductionCoolDown();
-                newEntities.push_back(child);
-            }
-        }
-        for(auto& ne : newEntities) {
-            entities.push_back(ne);
-        }
-
-        // 死亡したEntityを削除
-        entities.erase(
-            std::remove_if(entities.begin(), entities.end(),
-                [](std::shared_ptr<Entity> e){ return !e->isAlive(); }),
-            entities.end()
-        );
-
-        // Plant不足なら補充
-        int plantCount=0;
-        for(auto& e : entities) {
-            if(std::dynamic_pointer_cast<Plant>(e)) {
-                plantCount++;
-            }
-        }
-        if(plantCount < 15) {
-            for(int i=0; i<5; i++){
-                float x = getRandomFloat(50.f, 750.f);
-                float y = getRandomFloat(50.f, 550.f);
-                auto plant = std::make_shared<Plant>(sf::Vector2f(x,y));
-                entities.push_back(plant);
-            }
-        }
-
-        // 描画
+        // 最新のスナップショットを描画
+        snapshots.acquire();
+        const RenderSnapshot& snap = snapshots.readBuffer();
         window.clear();
-        drawBackground(window, sf::Color(220,220,220));
-
-        for(auto& e : entities){
-            e->draw(window);
-        }
+        renderer.draw(window, snap);
 
         // UI表示
         {
@@ -762,53 +6092,27 @@ int main()
             uiPanel.setPosition(20.f,20.f);
             window.draw(uiPanel);
 
-            int creatureCount=0;
-            float totalQ = 0.f;
-            int   qCount = 0;
-            int maxGen = 0;
-            std::map<std::string, int> speciesCount;
-
-            int plantCount2=0; 
-
-            for(auto& e : entities){
-                auto c = std::dynamic_pointer_cast<Creature>(e);
-                if(c) {
-                    creatureCount++;
-                    float qval = c->getAverageQ();
-                    totalQ += qval;
-                    qCount++;
-                    if(c->getGeneration() > maxGen) {
-                        maxGen = c->getGeneration();
-                    }
-                    speciesCount[c->getSpeciesName()]++;
-                }
-                else {
-                    auto p = std::dynamic_pointer_cast<Plant>(e);
-                    if(p) {
-                        plantCount2++;
-                    }
-                }
-            }
+            const SimStats& st = snap.stats;
 
-            float avgQ = (qCount > 0) ? (totalQ / qCount) : 0.f;
-
-            // 経過時間を h, m, s に分解
-            int h = static_cast<int>(totalElapsedTime / 3600);
-            int m = static_cast<int>((static_cast<int>(totalElapsedTime) % 3600) / 60);
-            int s = static_cast<int>(totalElapsedTime) % 60;
+            // シミュレーション内の経過時間を h, m, s に分解
+            float simTime = snap.tick * simDt;
+            int h = static_cast<int>(simTime / 3600);
+            int m = static_cast<int>((static_cast<int>(simTime) % 3600) / 60);
+            int s = static_cast<int>(simTime) % 60;
 
             std::string info;
             info += "FPS: " + std::to_string((int)fps) + "\n";
-            info += "Creature: " + std::to_string(creatureCount) + "\n";
-            info += "Plant:    " + std::to_string(plantCount2) + "\n";
-            info += "Max Gen:  " + std::to_string(maxGen) + "\n";
-            info += "Avg Q:    " + std::to_string(avgQ) + "\n";
+            info += "TPS: " + std::to_string((int)tps) + "\n";
+            info += "Creature: " + std::to_string(st.creatureCount) + "\n";
+            info += "Plant:    " + std::to_string(st.plantCount) + "\n";
+            info += "Max Gen:  " + std::to_string(st.maxGeneration) + "\n";
+            info += "Avg Q:    " + std::to_string(st.averageQ) + "\n";
             info += "Time: " + std::to_string(h) + "h"
                                  + std::to_string(m) + "m"
                                  + std::to_string(s) + "s\n";
 
             info += "\n--- Species Count ---\n";
-            for(const auto& kv : speciesCount) {
+            for(const auto& kv : st.speciesCount) {
                 info += kv.first + ": " + std::to_string(kv.second) + "\n";
             }
 
@@ -826,5 +6130,8 @@ int main()
         window.display();
     }
 
-    return 0;
+    simRunning = false;
+    if(control) control->interrupt();   // 一時停止中でも抜けられるように
+    simThread.join();
+    return finish(0);
 }